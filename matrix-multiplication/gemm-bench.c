@@ -0,0 +1,173 @@
+/**
+ * Benchmark of the packing stage of gemm().
+ *
+ * For every matrix size N it reports
+ *  - pack:     time spent copying A and B into the packed panels,
+ *  - kernel:   time of gemm() minus the packing time,
+ *  - gemm:     total time of gemm(),
+ *  - unpacked: the same blocked loop nest running a 4x8 register tile
+ *              directly on the row-major matrices, i.e. without packing.
+ * Run with GEMM_KERNEL=generic to compare packed and unpacked with the
+ * same (portable C) micro-kernel.
+ *
+ * C and the packing buffers are zeroed before the first timing, and
+ * every routine runs ROUNDS times: the first round is a warm-up (it also
+ * lets gemm() allocate its own packing buffers), the best of the others
+ * counts. So no timing includes first-touch page faults.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "gemm.h"
+#include "gemm-kernels.h"
+
+#define ROUNDS 3 // runs of every routine, the first only warms up
+
+static int min( int a, int b )
+{
+  return ( a < b )? a : b;
+}
+
+static double elapsed( struct timeval *tstart, struct timeval *tend )
+{
+  return (tend->tv_sec - tstart->tv_sec) + (tend->tv_usec - tstart->tv_usec) / 1000000.0;
+}
+
+/**
+ * Do exactly the packing work gemm() does for an N*N multiply.
+ */
+static void pack_only( int size, const double *A, const double *B,
+		       double *Ap, double *Bp )
+{
+  int jc, pc, ic, nc, kc, mc;
+
+  for (jc = 0; jc < size; jc += GEMM_NC) {
+    nc = min( GEMM_NC, size - jc );
+    for (pc = 0; pc < size; pc += GEMM_KC) {
+      kc = min( GEMM_KC, size - pc );
+      gemm_pack_b( kc, nc, &B[ pc * size + jc ], size, Bp );
+      for (ic = 0; ic < size; ic += GEMM_MC) {
+	mc = min( GEMM_MC, size - ic );
+	gemm_pack_a( mc, kc, &A[ ic * size + pc ], size, Ap );
+      }
+    }
+  }
+}
+
+/**
+ * Blocked multiply that reads A and B in place: A with stride 'size'
+ * down a column of the tile, B row by row.
+ */
+static void unpacked_gemm( int size, const double *A, const double *B, double *C )
+{
+  int jc, pc, ic, jr, ir, nc, kc, mc, nr, mr, i, j, p;
+
+  for (jc = 0; jc < size; jc += GEMM_NC) {
+    nc = min( GEMM_NC, size - jc );
+    for (pc = 0; pc < size; pc += GEMM_KC) {
+      kc = min( GEMM_KC, size - pc );
+      for (ic = 0; ic < size; ic += GEMM_MC) {
+	mc = min( GEMM_MC, size - ic );
+	for (jr = 0; jr < nc; jr += GEMM_NR) {
+	  nr = min( GEMM_NR, nc - jr );
+	  for (ir = 0; ir < mc; ir += GEMM_MR) {
+	    double acc[ GEMM_MR ][ GEMM_NR ] = {{ 0.0 }};
+	    const double *a = &A[ (ic+ir) * size + pc ];
+	    const double *b = &B[ pc * size + jc + jr ];
+	    double *c = &C[ (ic+ir) * size + jc + jr ];
+
+	    mr = min( GEMM_MR, mc - ir );
+	    for (p = 0; p < kc; ++p) {
+	      for (i = 0; i < mr; ++i) {
+		for (j = 0; j < nr; ++j) {
+		  acc[ i ][ j ] += a[ i * size + p ] * b[ p * size + j ];
+		}
+	      }
+	    }
+	    for (i = 0; i < mr; ++i) {
+	      for (j = 0; j < nr; ++j) {
+		c[ i * size + j ] = ( pc == 0 )? acc[ i ][ j ] : c[ i * size + j ] + acc[ i ][ j ];
+	      }
+	    }
+	  }
+	}
+      }
+    }
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+  int size, min_size, max_size, step, i, nc, round;
+  size_t ap_len, bp_len;
+  double *A, *B, *C, *Ap, *Bp;
+  double t, t_pack = 0.0, t_gemm = 0.0, t_unpacked = 0.0;
+  struct timeval tstart, tend;
+
+  if (argc != 4) {
+    fprintf( stderr, "%s <min size> <max size> <step>\n", argv[0] );
+    return -1;
+  }
+
+  min_size = atoi( argv[1] );
+  max_size = atoi( argv[2] );
+  step = atoi( argv[3] );
+
+  printf( "micro-kernel: %s\n", gemm_kernel_name() );
+  printf( "N\tpack(s)\tkernel(s)\tgemm(s)\tpack share\tunpacked(s)\tspeedup\n" );
+
+  for (size = min_size; size <= max_size; size += step) {
+    A = (double *) malloc( size * size * sizeof(double) );
+    B = (double *) malloc( size * size * sizeof(double) );
+    C = (double *) malloc( size * size * sizeof(double) );
+    nc = min( GEMM_NC, size );
+    ap_len = GEMM_MC * GEMM_KC * sizeof(double);
+    bp_len = GEMM_KC * ( (nc + GEMM_NR - 1) / GEMM_NR * GEMM_NR ) * sizeof(double);
+    Ap = (double *) aligned_alloc( GEMM_ALIGN, ap_len );
+    Bp = (double *) aligned_alloc( GEMM_ALIGN, bp_len );
+
+    for (i = 0; i < size * size; ++i) {
+      A[ i ] = 1.0;
+      B[ i ] = 1.0;
+    }
+    memset( C, 0, size * size * sizeof(double) );
+    memset( Ap, 0, ap_len );
+    memset( Bp, 0, bp_len );
+
+    for (round = 0; round < ROUNDS; ++round) {
+      gettimeofday( &tstart, NULL );
+      pack_only( size, A, B, Ap, Bp );
+      gettimeofday( &tend, NULL );
+      t = elapsed( &tstart, &tend );
+      if (round == 1 || (round > 1 && t < t_pack))
+	t_pack = t;
+
+      gettimeofday( &tstart, NULL );
+      gemm( size, size, size, A, size, B, size, 0.0, C, size );
+      gettimeofday( &tend, NULL );
+      t = elapsed( &tstart, &tend );
+      if (round == 1 || (round > 1 && t < t_gemm))
+	t_gemm = t;
+
+      gettimeofday( &tstart, NULL );
+      unpacked_gemm( size, A, B, C );
+      gettimeofday( &tend, NULL );
+      t = elapsed( &tstart, &tend );
+      if (round == 1 || (round > 1 && t < t_unpacked))
+	t_unpacked = t;
+    }
+
+    printf( "%d\t%.4lf\t%.4lf\t%.4lf\t%.1lf%%\t%.4lf\t%.2lf\n",
+	    size, t_pack, t_gemm - t_pack, t_gemm, 100.0 * t_pack / t_gemm,
+	    t_unpacked, t_unpacked / t_gemm );
+
+    free( A );
+    free( B );
+    free( C );
+    free( Ap );
+    free( Bp );
+  }
+
+  return 0;
+}
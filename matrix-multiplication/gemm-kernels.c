@@ -0,0 +1,282 @@
+/**
+ * Portable and SIMD micro-kernels for the blocked gemm engine, in
+ * double and single precision.
+ *
+ * The x86 kernels are compiled with per-function target attributes,
+ * so the whole file builds with plain -O2 and the right one is picked
+ * at run time with cpuid (__builtin_cpu_supports).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gemm.h"
+#include "gemm-kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Portable kernel for element type T, e.g.
+ * GENERIC_KERNEL( gemm_kernel_generic, double ).
+ */
+#define GENERIC_KERNEL( name, T )					\
+void name( int kc, const T *A, const T *B, T beta, T *C, int ldc )	\
+{									\
+  T acc[ GEMM_MR ][ GEMM_NR ] = {{ 0 }};				\
+  int i, j, p;								\
+									\
+  for (p = 0; p < kc; ++p) {						\
+    const T *a = &A[ p * GEMM_MR ];					\
+    const T *b = &B[ p * GEMM_NR ];					\
+    for (i = 0; i < GEMM_MR; ++i) {					\
+      for (j = 0; j < GEMM_NR; ++j) {					\
+	acc[ i ][ j ] += a[ i ] * b[ j ];				\
+      }									\
+    }									\
+  }									\
+									\
+  for (i = 0; i < GEMM_MR; ++i) {					\
+    for (j = 0; j < GEMM_NR; ++j) {					\
+      if (beta == 0)							\
+	C[ i * ldc + j ] = acc[ i ][ j ];				\
+      else								\
+	C[ i * ldc + j ] = beta * C[ i * ldc + j ] + acc[ i ][ j ];	\
+    }									\
+  }									\
+}
+
+GENERIC_KERNEL( gemm_kernel_generic, double )
+GENERIC_KERNEL( gemm_kernel_generic_s, float )
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* Each row of the 4x8 tile is held in four 128-bit registers. */
+__attribute__((target("sse2")))
+void gemm_kernel_sse2( int kc, const double *A, const double *B,
+		       double beta, double *C, int ldc )
+{
+  __m128d acc[ GEMM_MR ][ 4 ];
+  __m128d a, b0, b1, b2, b3, vbeta;
+  int i, p;
+
+  for (i = 0; i < GEMM_MR; ++i) {
+    acc[ i ][ 0 ] = acc[ i ][ 1 ] = acc[ i ][ 2 ] = acc[ i ][ 3 ] = _mm_setzero_pd();
+  }
+
+  for (p = 0; p < kc; ++p) {
+    const double *b = &B[ p * GEMM_NR ];
+    b0 = _mm_load_pd( b );
+    b1 = _mm_load_pd( b + 2 );
+    b2 = _mm_load_pd( b + 4 );
+    b3 = _mm_load_pd( b + 6 );
+    for (i = 0; i < GEMM_MR; ++i) {
+      a = _mm_set1_pd( A[ p * GEMM_MR + i ] );
+      acc[ i ][ 0 ] = _mm_add_pd( acc[ i ][ 0 ], _mm_mul_pd( a, b0 ) );
+      acc[ i ][ 1 ] = _mm_add_pd( acc[ i ][ 1 ], _mm_mul_pd( a, b1 ) );
+      acc[ i ][ 2 ] = _mm_add_pd( acc[ i ][ 2 ], _mm_mul_pd( a, b2 ) );
+      acc[ i ][ 3 ] = _mm_add_pd( acc[ i ][ 3 ], _mm_mul_pd( a, b3 ) );
+    }
+  }
+
+  vbeta = _mm_set1_pd( beta );
+  for (i = 0; i < GEMM_MR; ++i) {
+    double *c = &C[ i * ldc ];
+    int v;
+    for (v = 0; v < 4; ++v) {
+      if (beta != 0.0)
+	acc[ i ][ v ] = _mm_add_pd( _mm_mul_pd( vbeta, _mm_loadu_pd( c + 2*v ) ),
+				    acc[ i ][ v ] );
+      _mm_storeu_pd( c + 2*v, acc[ i ][ v ] );
+    }
+  }
+}
+
+/* Each row of the 4x8 tile is held in two 256-bit registers and
+   updated with fused multiply-add. */
+__attribute__((target("avx2,fma")))
+void gemm_kernel_avx2( int kc, const double *A, const double *B,
+		       double beta, double *C, int ldc )
+{
+  __m256d c00, c01, c10, c11, c20, c21, c30, c31;
+  __m256d a, b0, b1, vbeta;
+  int p;
+
+  c00 = c01 = c10 = c11 = c20 = c21 = c30 = c31 = _mm256_setzero_pd();
+
+  for (p = 0; p < kc; ++p) {
+    b0 = _mm256_load_pd( &B[ p * GEMM_NR ] );
+    b1 = _mm256_load_pd( &B[ p * GEMM_NR + 4 ] );
+
+    a = _mm256_broadcast_sd( &A[ p * GEMM_MR ] );
+    c00 = _mm256_fmadd_pd( a, b0, c00 );
+    c01 = _mm256_fmadd_pd( a, b1, c01 );
+    a = _mm256_broadcast_sd( &A[ p * GEMM_MR + 1 ] );
+    c10 = _mm256_fmadd_pd( a, b0, c10 );
+    c11 = _mm256_fmadd_pd( a, b1, c11 );
+    a = _mm256_broadcast_sd( &A[ p * GEMM_MR + 2 ] );
+    c20 = _mm256_fmadd_pd( a, b0, c20 );
+    c21 = _mm256_fmadd_pd( a, b1, c21 );
+    a = _mm256_broadcast_sd( &A[ p * GEMM_MR + 3 ] );
+    c30 = _mm256_fmadd_pd( a, b0, c30 );
+    c31 = _mm256_fmadd_pd( a, b1, c31 );
+  }
+
+  if (beta != 0.0) {
+    vbeta = _mm256_set1_pd( beta );
+    c00 = _mm256_fmadd_pd( vbeta, _mm256_loadu_pd( &C[ 0 ] ), c00 );
+    c01 = _mm256_fmadd_pd( vbeta, _mm256_loadu_pd( &C[ 4 ] ), c01 );
+    c10 = _mm256_fmadd_pd( vbeta, _mm256_loadu_pd( &C[ ldc ] ), c10 );
+    c11 = _mm256_fmadd_pd( vbeta, _mm256_loadu_pd( &C[ ldc + 4 ] ), c11 );
+    c20 = _mm256_fmadd_pd( vbeta, _mm256_loadu_pd( &C[ 2 * ldc ] ), c20 );
+    c21 = _mm256_fmadd_pd( vbeta, _mm256_loadu_pd( &C[ 2 * ldc + 4 ] ), c21 );
+    c30 = _mm256_fmadd_pd( vbeta, _mm256_loadu_pd( &C[ 3 * ldc ] ), c30 );
+    c31 = _mm256_fmadd_pd( vbeta, _mm256_loadu_pd( &C[ 3 * ldc + 4 ] ), c31 );
+  }
+
+  _mm256_storeu_pd( &C[ 0 ], c00 );
+  _mm256_storeu_pd( &C[ 4 ], c01 );
+  _mm256_storeu_pd( &C[ ldc ], c10 );
+  _mm256_storeu_pd( &C[ ldc + 4 ], c11 );
+  _mm256_storeu_pd( &C[ 2 * ldc ], c20 );
+  _mm256_storeu_pd( &C[ 2 * ldc + 4 ], c21 );
+  _mm256_storeu_pd( &C[ 3 * ldc ], c30 );
+  _mm256_storeu_pd( &C[ 3 * ldc + 4 ], c31 );
+}
+
+/* Each row of the 4x8 tile fits in a single 512-bit register. */
+__attribute__((target("avx512f")))
+void gemm_kernel_avx512( int kc, const double *A, const double *B,
+			 double beta, double *C, int ldc )
+{
+  __m512d c0, c1, c2, c3, b, vbeta;
+  int p;
+
+  c0 = c1 = c2 = c3 = _mm512_setzero_pd();
+
+  for (p = 0; p < kc; ++p) {
+    b = _mm512_load_pd( &B[ p * GEMM_NR ] );
+    c0 = _mm512_fmadd_pd( _mm512_set1_pd( A[ p * GEMM_MR ] ), b, c0 );
+    c1 = _mm512_fmadd_pd( _mm512_set1_pd( A[ p * GEMM_MR + 1 ] ), b, c1 );
+    c2 = _mm512_fmadd_pd( _mm512_set1_pd( A[ p * GEMM_MR + 2 ] ), b, c2 );
+    c3 = _mm512_fmadd_pd( _mm512_set1_pd( A[ p * GEMM_MR + 3 ] ), b, c3 );
+  }
+
+  if (beta != 0.0) {
+    vbeta = _mm512_set1_pd( beta );
+    c0 = _mm512_fmadd_pd( vbeta, _mm512_loadu_pd( &C[ 0 ] ), c0 );
+    c1 = _mm512_fmadd_pd( vbeta, _mm512_loadu_pd( &C[ ldc ] ), c1 );
+    c2 = _mm512_fmadd_pd( vbeta, _mm512_loadu_pd( &C[ 2 * ldc ] ), c2 );
+    c3 = _mm512_fmadd_pd( vbeta, _mm512_loadu_pd( &C[ 3 * ldc ] ), c3 );
+  }
+
+  _mm512_storeu_pd( &C[ 0 ], c0 );
+  _mm512_storeu_pd( &C[ ldc ], c1 );
+  _mm512_storeu_pd( &C[ 2 * ldc ], c2 );
+  _mm512_storeu_pd( &C[ 3 * ldc ], c3 );
+}
+
+/* Single precision: each row of the 4x8 tile is one 256-bit register.
+   Four accumulators cannot hide the latency of the FMA, so even and
+   odd k go to two sets that are added at the end. */
+__attribute__((target("avx2,fma")))
+void gemm_kernel_avx2_s( int kc, const float *A, const float *B,
+			 float beta, float *C, int ldc )
+{
+  __m256 c0, c1, c2, c3, d0, d1, d2, d3, b, e, vbeta;
+  int p;
+
+  c0 = c1 = c2 = c3 = d0 = d1 = d2 = d3 = _mm256_setzero_ps();
+
+  for (p = 0; p + 1 < kc; p += 2) {
+    b = _mm256_load_ps( &B[ p * GEMM_NR ] );
+    e = _mm256_load_ps( &B[ (p+1) * GEMM_NR ] );
+    c0 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ p * GEMM_MR ] ), b, c0 );
+    c1 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ p * GEMM_MR + 1 ] ), b, c1 );
+    c2 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ p * GEMM_MR + 2 ] ), b, c2 );
+    c3 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ p * GEMM_MR + 3 ] ), b, c3 );
+    d0 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ (p+1) * GEMM_MR ] ), e, d0 );
+    d1 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ (p+1) * GEMM_MR + 1 ] ), e, d1 );
+    d2 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ (p+1) * GEMM_MR + 2 ] ), e, d2 );
+    d3 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ (p+1) * GEMM_MR + 3 ] ), e, d3 );
+  }
+  if (p < kc) {
+    b = _mm256_load_ps( &B[ p * GEMM_NR ] );
+    c0 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ p * GEMM_MR ] ), b, c0 );
+    c1 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ p * GEMM_MR + 1 ] ), b, c1 );
+    c2 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ p * GEMM_MR + 2 ] ), b, c2 );
+    c3 = _mm256_fmadd_ps( _mm256_broadcast_ss( &A[ p * GEMM_MR + 3 ] ), b, c3 );
+  }
+  c0 = _mm256_add_ps( c0, d0 );
+  c1 = _mm256_add_ps( c1, d1 );
+  c2 = _mm256_add_ps( c2, d2 );
+  c3 = _mm256_add_ps( c3, d3 );
+
+  if (beta != 0.0f) {
+    vbeta = _mm256_set1_ps( beta );
+    c0 = _mm256_fmadd_ps( vbeta, _mm256_loadu_ps( &C[ 0 ] ), c0 );
+    c1 = _mm256_fmadd_ps( vbeta, _mm256_loadu_ps( &C[ ldc ] ), c1 );
+    c2 = _mm256_fmadd_ps( vbeta, _mm256_loadu_ps( &C[ 2 * ldc ] ), c2 );
+    c3 = _mm256_fmadd_ps( vbeta, _mm256_loadu_ps( &C[ 3 * ldc ] ), c3 );
+  }
+
+  _mm256_storeu_ps( &C[ 0 ], c0 );
+  _mm256_storeu_ps( &C[ ldc ], c1 );
+  _mm256_storeu_ps( &C[ 2 * ldc ], c2 );
+  _mm256_storeu_ps( &C[ 3 * ldc ], c3 );
+}
+
+#endif
+
+gemm_kernel_fn gemm_select_kernel( const char **name )
+{
+  const char *want = getenv( "GEMM_KERNEL" );
+
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+
+  if (want == NULL || strcmp( want, "avx512" ) == 0) {
+    if (__builtin_cpu_supports( "avx512f" )) {
+      *name = "avx512";
+      return gemm_kernel_avx512;
+    }
+  }
+  if (want == NULL || strcmp( want, "avx2" ) == 0) {
+    if (__builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" )) {
+      *name = "avx2";
+      return gemm_kernel_avx2;
+    }
+  }
+  if (want == NULL || strcmp( want, "sse2" ) == 0) {
+    if (__builtin_cpu_supports( "sse2" )) {
+      *name = "sse2";
+      return gemm_kernel_sse2;
+    }
+  }
+#endif
+
+  if (want != NULL && strcmp( want, "generic" ) != 0) {
+    fprintf( stderr, "GEMM_KERNEL=%s is not supported on this CPU, using generic\n", want );
+  }
+  *name = "generic";
+  return gemm_kernel_generic;
+}
+
+gemm_kernel_fn_s gemm_select_kernel_s( const char **name )
+{
+  const char *want = getenv( "GEMM_KERNEL" );
+
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+
+  if (want == NULL || strcmp( want, "avx512" ) == 0 || strcmp( want, "avx2" ) == 0) {
+    if (__builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" )) {
+      *name = "avx2";
+      return gemm_kernel_avx2_s;
+    }
+  }
+#endif
+
+  *name = "generic";
+  return gemm_kernel_generic_s;
+}
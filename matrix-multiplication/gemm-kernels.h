@@ -0,0 +1,60 @@
+/**
+ * GEMM_MR x GEMM_NR micro-kernels used by gemm.c.
+ *
+ * Every kernel computes
+ * C <- A * B + beta * C
+ * for one register tile, where A is a packed GEMM_MR x kc sliver
+ * (GEMM_MR values of one column after another) and B is a packed
+ * kc x GEMM_NR sliver (GEMM_NR values of one row after another).
+ * Both slivers are aligned to GEMM_ALIGN bytes.
+ */
+#ifndef GEMM_KERNELS_H
+#define GEMM_KERNELS_H
+
+typedef void (*gemm_kernel_fn)( int kc, const double *A, const double *B,
+				double beta, double *C, int ldc );
+typedef void (*gemm_kernel_fn_s)( int kc, const float *A, const float *B,
+				  float beta, float *C, int ldc );
+
+void gemm_kernel_generic( int kc, const double *A, const double *B,
+			  double beta, double *C, int ldc );
+void gemm_kernel_generic_s( int kc, const float *A, const float *B,
+			    float beta, float *C, int ldc );
+
+#if defined(__x86_64__) || defined(__i386__)
+void gemm_kernel_sse2( int kc, const double *A, const double *B,
+		       double beta, double *C, int ldc );
+void gemm_kernel_avx2( int kc, const double *A, const double *B,
+		       double beta, double *C, int ldc );
+void gemm_kernel_avx512( int kc, const double *A, const double *B,
+			 double beta, double *C, int ldc );
+void gemm_kernel_avx2_s( int kc, const float *A, const float *B,
+			 float beta, float *C, int ldc );
+#endif
+
+/**
+ * Copy an mc x kc block of A into GEMM_MR-row slivers and a kc x nc
+ * panel of B into GEMM_NR-column slivers, zero padding the last sliver.
+ * The _sd variants widen float operands for the double kernels.
+ */
+void gemm_pack_a( int mc, int kc, const double *A, int lda, double *Ap );
+void gemm_pack_b( int kc, int nc, const double *B, int ldb, double *Bp );
+void gemm_pack_a_s( int mc, int kc, const float *A, int lda, float *Ap );
+void gemm_pack_b_s( int kc, int nc, const float *B, int ldb, float *Bp );
+void gemm_pack_a_sd( int mc, int kc, const float *A, int lda, double *Ap );
+void gemm_pack_b_sd( int kc, int nc, const float *B, int ldb, double *Bp );
+
+/**
+ * Pick the best kernel the CPU supports. The environment variable
+ * GEMM_KERNEL (generic, sse2, avx2 or avx512) overrides the choice,
+ * which is handy for comparing kernels on the same machine.
+ * 'name' receives the name of the selected kernel.
+ *
+ * Single precision only has an avx2 kernel (a 4x8 float tile is one
+ * 256-bit register per row): GEMM_KERNEL=avx512 selects it too and
+ * sse2 the generic one.
+ */
+gemm_kernel_fn gemm_select_kernel( const char **name );
+gemm_kernel_fn_s gemm_select_kernel_s( const char **name );
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * Body of the gemm engine for one precision. gemm.c includes it once
+ * per precision with
+ *   GEMM_T                  element type of A and B,
+ *   GEMM_ACC_T              element type of C, of 'beta', of the packed
+ *                           panels and of the micro-kernel,
+ *   GEMM_NAME(name)         name of the instance of 'name',
+ *   GEMM_KERNEL_NAME(name)  name of 'name' in the micro-kernel layer of
+ *                           GEMM_ACC_T (see gemm-kernels.h)
+ * defined, and undefines them afterwards. A and B are converted to
+ * GEMM_ACC_T while they are packed, so a float A and B multiplied into
+ * a double C run the double micro-kernels.
+ */
+
+static GEMM_KERNEL_NAME( gemm_kernel_fn ) GEMM_NAME( micro_kernel ) = NULL;
+static const char *GEMM_NAME( micro_kernel_name ) = NULL;
+static pthread_once_t GEMM_NAME( kernel_once ) = PTHREAD_ONCE_INIT;
+
+/**
+ * Resolve the micro-kernel. Run through pthread_once(), which also
+ * publishes both statics to every thread that returns from it.
+ */
+static void GEMM_NAME( init_kernel )( void )
+{
+  const char *name;
+  GEMM_KERNEL_NAME( gemm_kernel_fn ) kernel = GEMM_KERNEL_NAME( gemm_select_kernel )( &name );
+
+  GEMM_NAME( micro_kernel_name ) = name;
+  GEMM_NAME( micro_kernel ) = kernel;
+}
+
+const char *GEMM_NAME( gemm_kernel_name )( void )
+{
+  pthread_once( &GEMM_NAME( kernel_once ), GEMM_NAME( init_kernel ) );
+  return GEMM_NAME( micro_kernel_name );
+}
+
+void GEMM_NAME( gemm_pack_a )( int mc, int kc, const GEMM_T *A, int lda, GEMM_ACC_T *Ap )
+{
+  int ir, mr, i, p;
+
+  for (ir = 0; ir < mc; ir += GEMM_MR) {
+    mr = min( GEMM_MR, mc - ir );
+    for (p = 0; p < kc; ++p) {
+      for (i = 0; i < mr; ++i) {
+	Ap[ i ] = A[ (ir+i) * lda + p ];
+      }
+      for (; i < GEMM_MR; ++i) { // pad the last sliver with zeros.
+	Ap[ i ] = 0;
+      }
+      Ap += GEMM_MR;
+    }
+  }
+}
+
+void GEMM_NAME( gemm_pack_b )( int kc, int nc, const GEMM_T *B, int ldb, GEMM_ACC_T *Bp )
+{
+  int jr, nr, j, p;
+
+  for (jr = 0; jr < nc; jr += GEMM_NR) {
+    nr = min( GEMM_NR, nc - jr );
+    for (p = 0; p < kc; ++p) {
+      const GEMM_T *b = &B[ p * ldb + jr ];
+      for (j = 0; j < nr; ++j) {
+	Bp[ j ] = b[ j ];
+      }
+      for (; j < GEMM_NR; ++j) { // pad the last sliver with zeros.
+	Bp[ j ] = 0;
+      }
+      Bp += GEMM_NR;
+    }
+  }
+}
+
+/**
+ * Partial tiles on the bottom and right edges of C (mr <= GEMM_MR,
+ * nr <= GEMM_NR). The packed slivers are zero padded, so the full
+ * micro-kernel runs on a scratch tile and only the valid part is
+ * merged into C.
+ */
+static void GEMM_NAME( edge_kernel )( int mr, int nr, int kc, const GEMM_ACC_T *Ap,
+				      const GEMM_ACC_T *Bp, GEMM_ACC_T beta,
+				      GEMM_ACC_T *C, int ldc )
+{
+  GEMM_ACC_T tile[ GEMM_MR * GEMM_NR ] __attribute__((aligned(GEMM_ALIGN)));
+  int i, j;
+
+  GEMM_NAME( micro_kernel )( kc, Ap, Bp, 0, tile, GEMM_NR );
+
+  for (i = 0; i < mr; ++i) {
+    for (j = 0; j < nr; ++j) {
+      if (beta == 0)
+	C[ i * ldc + j ] = tile[ i * GEMM_NR + j ];
+      else
+	C[ i * ldc + j ] = beta * C[ i * ldc + j ] + tile[ i * GEMM_NR + j ];
+    }
+  }
+}
+
+void GEMM_NAME( gemm )( int m, int n, int k,
+			const GEMM_T *A, int lda,
+			const GEMM_T *B, int ldb,
+			GEMM_ACC_T beta, GEMM_ACC_T *C, int ldc )
+{
+  int jc, pc, ic, jr, ir, nc, kc, mc, nr, mr, i, j;
+  GEMM_ACC_T b, *Ap, *Bp;
+
+  pthread_once( &GEMM_NAME( kernel_once ), GEMM_NAME( init_kernel ) );
+
+  if (k <= 0) { // nothing to multiply, only scale C.
+    for (i = 0; i < m; ++i) {
+      for (j = 0; j < n; ++j) {
+	C[ i * ldc + j ] = ( beta == 0 )? 0 : beta * C[ i * ldc + j ];
+      }
+    }
+    return;
+  }
+
+  Ap = (GEMM_ACC_T *) reserve( &pack_a, &pack_a_len, GEMM_MC * GEMM_KC * sizeof(GEMM_ACC_T) );
+  nc = min( GEMM_NC, n );
+  Bp = (GEMM_ACC_T *) reserve( &pack_b, &pack_b_len,
+			       (size_t) GEMM_KC * ( (nc + GEMM_NR - 1) / GEMM_NR * GEMM_NR ) * sizeof(GEMM_ACC_T) );
+
+  for (jc = 0; jc < n; jc += GEMM_NC) {
+    nc = min( GEMM_NC, n - jc );
+    for (pc = 0; pc < k; pc += GEMM_KC) {
+      kc = min( GEMM_KC, k - pc );
+      b = ( pc == 0 )? beta : 1; // later depth blocks accumulate.
+      GEMM_NAME( gemm_pack_b )( kc, nc, &B[ pc * ldb + jc ], ldb, Bp );
+      for (ic = 0; ic < m; ic += GEMM_MC) {
+	mc = min( GEMM_MC, m - ic );
+	GEMM_NAME( gemm_pack_a )( mc, kc, &A[ ic * lda + pc ], lda, Ap );
+	for (jr = 0; jr < nc; jr += GEMM_NR) {
+	  nr = min( GEMM_NR, nc - jr );
+	  for (ir = 0; ir < mc; ir += GEMM_MR) {
+	    mr = min( GEMM_MR, mc - ir );
+	    const GEMM_ACC_T *a = &Ap[ ir * kc ];
+	    const GEMM_ACC_T *bp = &Bp[ jr * kc ];
+	    GEMM_ACC_T *c = &C[ (ic+ir) * ldc + jc + jr ];
+	    if (mr == GEMM_MR && nr == GEMM_NR)
+	      GEMM_NAME( micro_kernel )( kc, a, bp, b, c, ldc );
+	    else
+	      GEMM_NAME( edge_kernel )( mr, nr, kc, a, bp, b, c, ldc );
+	  }
+	}
+      }
+    }
+  }
+}
@@ -0,0 +1,212 @@
+/**
+ * Bit-for-bit check of the gemm micro-kernels.
+ *
+ * Every kernel of gemm-kernels.h this CPU supports is run on the same
+ * packed panels, tile by tile, into a C with a leading dimension that
+ * is neither the tile width nor a multiple of the vector width. The
+ * panels are packed from blocks that do not divide into whole tiles, so
+ * the zero padded slivers of the edges are covered as well.
+ *
+ * Each result is compared exactly with a scalar reference that adds
+ * the products in the same order as the kernel: in k order with a
+ * separate multiply and add (generic, sse2), with fused multiply-adds
+ * (avx2, avx512), or in two fused chains over even and odd k that are
+ * added at the end (avx2_s). Entries of C outside the tiles must be
+ * left untouched.
+ *
+ * Returns non-zero if any kernel differs from its reference.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gemm.h"
+#include "gemm-kernels.h"
+
+#define LDC_PAD 3 // extra columns of C after the last tile
+
+/* Order in which a kernel adds up the products of a tile entry. */
+#define ORDER_MUL_ADD 0 // acc + a*b, rounded twice
+#define ORDER_FMA 1 // fma( a, b, acc )
+#define ORDER_FMA_EVEN_ODD 2 // even and odd k in two fma chains
+
+/* Blocks of A (mc x kc) and B (kc x nc) that are packed and multiplied. */
+static const int shapes[][ 3 ] = {
+  /* mc, nc, kc */
+  { 4, 8, 1 },
+  { 4, 8, 2 },
+  { 7, 13, 3 },
+  { 9, 17, 8 },
+  { 3, 5, 31 },
+  { 12, 24, 256 },
+  { 13, 9, 301 },
+};
+
+static const double betas[] = { 0.0, 1.0, -0.75 };
+
+/*
+ * Scalar reference of one GEMM_MR x GEMM_NR tile for element type T,
+ * with FMA the fused multiply-add of T.
+ */
+#define REFERENCE_KERNEL( name, T, FMA )				\
+static void name( int order, int kc, const T *A, const T *B,		\
+		  T beta, T *C, int ldc )				\
+{									\
+  T acc, odd;								\
+  int i, j, p;								\
+									\
+  for (i = 0; i < GEMM_MR; ++i) {					\
+    for (j = 0; j < GEMM_NR; ++j) {					\
+      acc = odd = 0;							\
+      for (p = 0; p < kc; ++p) {					\
+	T a = A[ p * GEMM_MR + i ], b = B[ p * GEMM_NR + j ];		\
+	if (order == ORDER_MUL_ADD) {					\
+	  T prod = a * b;						\
+	  acc = acc + prod;						\
+	} else if (order == ORDER_FMA_EVEN_ODD && p % 2 == 1) {		\
+	  odd = FMA( a, b, odd );					\
+	} else {							\
+	  acc = FMA( a, b, acc );					\
+	}								\
+      }									\
+      if (order == ORDER_FMA_EVEN_ODD)					\
+	acc = acc + odd;						\
+      if (beta == 0)							\
+	C[ i * ldc + j ] = acc;						\
+      else if (order == ORDER_MUL_ADD) {				\
+	T scaled = beta * C[ i * ldc + j ];				\
+	C[ i * ldc + j ] = scaled + acc;				\
+      } else								\
+	C[ i * ldc + j ] = FMA( beta, C[ i * ldc + j ], acc );		\
+    }									\
+  }									\
+}
+
+REFERENCE_KERNEL( reference_kernel, double, fma )
+REFERENCE_KERNEL( reference_kernel_s, float, fmaf )
+
+static int supported( const char *feature )
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (strcmp( feature, "avx2" ) == 0)
+    return __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+  if (strcmp( feature, "avx512f" ) == 0)
+    return __builtin_cpu_supports( "avx512f" );
+  if (strcmp( feature, "sse2" ) == 0)
+    return __builtin_cpu_supports( "sse2" );
+#endif
+  return 0;
+}
+
+static double value( void )
+{
+  return (rand() % 2001 - 1000) / 997.0;
+}
+
+static void *allocate( size_t len )
+{
+  void *p;
+
+  if (posix_memalign( &p, GEMM_ALIGN, len ) != 0) {
+    fprintf( stderr, "gemm-test: cannot allocate %zu bytes\n", len );
+    exit( -1 );
+  }
+  return p;
+}
+
+/*
+ * The test of one kernel for element type T: pack every shape, run the
+ * kernel and the reference on copies of the same C, compare them.
+ * Returns the number of shapes and betas that mismatch.
+ */
+#define KERNEL_TEST( name, T, PACK_A, PACK_B, REFERENCE, FN )		\
+static int name( const char *kernel_name, FN kernel, int order )	\
+{									\
+  int s, t, i, ir, jr, mc, nc, kc, mp, np, ldc, failed = 0;		\
+  T *A, *B, *Ap, *Bp, *C, *R;						\
+									\
+  for (s = 0; s < (int) (sizeof(shapes) / sizeof(shapes[ 0 ])); ++s) { \
+    mc = shapes[ s ][ 0 ];						\
+    nc = shapes[ s ][ 1 ];						\
+    kc = shapes[ s ][ 2 ];						\
+    mp = (mc + GEMM_MR - 1) / GEMM_MR * GEMM_MR;			\
+    np = (nc + GEMM_NR - 1) / GEMM_NR * GEMM_NR;			\
+    ldc = np + LDC_PAD;							\
+    A = (T *) allocate( (size_t) mc * (kc + 1) * sizeof(T) );		\
+    B = (T *) allocate( (size_t) kc * (nc + 2) * sizeof(T) );		\
+    Ap = (T *) allocate( (size_t) mp * kc * sizeof(T) );		\
+    Bp = (T *) allocate( (size_t) np * kc * sizeof(T) );		\
+    C = (T *) allocate( (size_t) mp * ldc * sizeof(T) );		\
+    R = (T *) allocate( (size_t) mp * ldc * sizeof(T) );		\
+    for (i = 0; i < mc * (kc + 1); ++i) A[ i ] = value();		\
+    for (i = 0; i < kc * (nc + 2); ++i) B[ i ] = value();		\
+    PACK_A( mc, kc, A, kc + 1, Ap );					\
+    PACK_B( kc, nc, B, nc + 2, Bp );					\
+									\
+    for (t = 0; t < (int) (sizeof(betas) / sizeof(betas[ 0 ])); ++t) { \
+      for (i = 0; i < mp * ldc; ++i)					\
+	R[ i ] = C[ i ] = ( betas[ t ] == 0 )? NAN : value();		\
+      for (ir = 0; ir < mp; ir += GEMM_MR) {				\
+	for (jr = 0; jr < np; jr += GEMM_NR) {				\
+	  kernel( kc, &Ap[ ir * kc ], &Bp[ jr * kc ], betas[ t ],	\
+		  &C[ ir * ldc + jr ], ldc );				\
+	  REFERENCE( order, kc, &Ap[ ir * kc ], &Bp[ jr * kc ], betas[ t ], \
+		     &R[ ir * ldc + jr ], ldc );			\
+	}								\
+      }									\
+      for (i = 0; i < mp * ldc; ++i) {					\
+	if (memcmp( &C[ i ], &R[ i ], sizeof(T) ) != 0) {		\
+	  printf( "%s: mc %d nc %d kc %d beta %g: C[%d][%d] = %.17g, expected %.17g\n", \
+		  kernel_name, mc, nc, kc, betas[ t ], i / ldc, i % ldc, \
+		  (double) C[ i ], (double) R[ i ] );			\
+	  ++failed;							\
+	  break;							\
+	}								\
+      }									\
+    }									\
+									\
+    free( A ); free( B ); free( Ap ); free( Bp ); free( C ); free( R ); \
+  }									\
+  return failed;							\
+}
+
+KERNEL_TEST( test_kernel, double, gemm_pack_a, gemm_pack_b, reference_kernel, gemm_kernel_fn )
+KERNEL_TEST( test_kernel_s, float, gemm_pack_a_s, gemm_pack_b_s, reference_kernel_s, gemm_kernel_fn_s )
+
+int main( void )
+{
+  struct {
+    const char *name;
+    const char *feature; // NULL when every CPU runs it
+    gemm_kernel_fn kernel;
+    gemm_kernel_fn_s kernel_s;
+    int order;
+  } kernels[] = {
+    { "generic", NULL, gemm_kernel_generic, NULL, ORDER_MUL_ADD },
+    { "generic_s", NULL, NULL, gemm_kernel_generic_s, ORDER_MUL_ADD },
+#if defined(__x86_64__) || defined(__i386__)
+    { "sse2", "sse2", gemm_kernel_sse2, NULL, ORDER_MUL_ADD },
+    { "avx2", "avx2", gemm_kernel_avx2, NULL, ORDER_FMA },
+    { "avx512", "avx512f", gemm_kernel_avx512, NULL, ORDER_FMA },
+    { "avx2_s", "avx2", NULL, gemm_kernel_avx2_s, ORDER_FMA_EVEN_ODD },
+#endif
+  };
+  int k, failed, total = 0;
+
+  for (k = 0; k < (int) (sizeof(kernels) / sizeof(kernels[ 0 ])); ++k) {
+    if (kernels[ k ].feature != NULL && !supported( kernels[ k ].feature )) {
+      printf( "%s\tskipped, not supported by this CPU\n", kernels[ k ].name );
+      continue;
+    }
+    srand( 1 );
+    if (kernels[ k ].kernel != NULL)
+      failed = test_kernel( kernels[ k ].name, kernels[ k ].kernel, kernels[ k ].order );
+    else
+      failed = test_kernel_s( kernels[ k ].name, kernels[ k ].kernel_s, kernels[ k ].order );
+    printf( "%s\t%s\n", kernels[ k ].name, failed ? "FAILED" : "ok" );
+    total += failed;
+  }
+
+  return total != 0;
+}
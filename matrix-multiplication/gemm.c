@@ -0,0 +1,92 @@
+/**
+ * Cache-blocked, register-tiled matrix multiplication.
+ *
+ * The loop nest follows the usual five-loop structure:
+ *   jc: GEMM_NC columns of B/C   (L3)
+ *   pc: GEMM_KC depth            (L2/L1)
+ *   ic: GEMM_MC rows of A/C      (L2)
+ *   jr: GEMM_NR columns          (micro-kernel)
+ *   ir: GEMM_MR rows             (micro-kernel)
+ * Only the first 'pc' block applies 'beta', the others accumulate.
+ *
+ * Each KC x NC panel of B and MC x KC block of A is first copied into
+ * an aligned buffer in the order the micro-kernel reads it (slivers of
+ * GEMM_NR columns of B, slivers of GEMM_MR rows of A), so the kernel
+ * streams both operands with unit stride whatever 'lda' and 'ldb' are.
+ * Full tiles go to the SIMD micro-kernel picked for this CPU in
+ * gemm-kernels.c, partial tiles on the edges to edge_kernel().
+ *
+ * The engine itself lives in gemm-template.h and is instantiated here
+ * for three precisions:
+ *   gemm()     double A, B and C,
+ *   gemm_s()   float A, B and C,
+ *   gemm_sd()  float A and B, double C; the operands are widened to
+ *              double when they are packed, so the products are
+ *              accumulated by the double micro-kernels.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "gemm.h"
+#include "gemm-kernels.h"
+
+static int min( int a, int b )
+{
+  return ( a < b )? a : b;
+}
+
+/* Per-thread packing buffers. They are reused by every call made from
+   the same thread, whatever the precision, and only grow when a larger
+   panel is needed. */
+static __thread void *pack_a = NULL;
+static __thread void *pack_b = NULL;
+static __thread size_t pack_a_len = 0;
+static __thread size_t pack_b_len = 0;
+
+/**
+ * Return an aligned buffer of at least 'len' bytes, reusing '*buf'
+ * when it is already big enough.
+ */
+static void *reserve( void **buf, size_t *cur_len, size_t len )
+{
+  if (*buf != NULL && *cur_len >= len)
+    return *buf;
+
+  free( *buf );
+  if (posix_memalign( buf, GEMM_ALIGN, len ) != 0) {
+    fprintf( stderr, "gemm: cannot allocate %zu bytes of packing buffer\n", len );
+    exit( -1 );
+  }
+  *cur_len = len;
+  return *buf;
+}
+
+#define GEMM_T double
+#define GEMM_ACC_T double
+#define GEMM_NAME( name ) name
+#define GEMM_KERNEL_NAME( name ) name
+#include "gemm-template.h"
+#undef GEMM_T
+#undef GEMM_ACC_T
+#undef GEMM_NAME
+#undef GEMM_KERNEL_NAME
+
+#define GEMM_T float
+#define GEMM_ACC_T float
+#define GEMM_NAME( name ) name ## _s
+#define GEMM_KERNEL_NAME( name ) name ## _s
+#include "gemm-template.h"
+#undef GEMM_T
+#undef GEMM_ACC_T
+#undef GEMM_NAME
+#undef GEMM_KERNEL_NAME
+
+#define GEMM_T float
+#define GEMM_ACC_T double
+#define GEMM_NAME( name ) name ## _sd
+#define GEMM_KERNEL_NAME( name ) name
+#include "gemm-template.h"
+#undef GEMM_T
+#undef GEMM_ACC_T
+#undef GEMM_NAME
+#undef GEMM_KERNEL_NAME
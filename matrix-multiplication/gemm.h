@@ -0,0 +1,65 @@
+/**
+ * Cache-blocked matrix multiplication engine shared by all the
+ * matrix-mul-* drivers.
+ *
+ * Matrices are stored row-major and addressed through a leading
+ * dimension, so a strip or a tile of a larger matrix can be passed
+ * in directly, e.g. 'matrix1[row_start]' with 'lda = size'.
+ */
+#ifndef GEMM_H
+#define GEMM_H
+
+/* Register tile computed by the micro-kernel: GEMM_MR x GEMM_NR
+   accumulators of C live in registers across the whole k loop. */
+#define GEMM_MR 4
+#define GEMM_NR 8
+
+/* Cache blocks. A GEMM_KC x GEMM_NR sliver of B stays in L1,
+   a GEMM_MC x GEMM_KC block of A stays in L2 and a GEMM_KC x GEMM_NC
+   panel of B stays in L3 while it is being reused. */
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 4096
+
+/* Alignment in bytes of the packed panels (one cache line). */
+#define GEMM_ALIGN 64
+
+/**
+ * Calculate:
+ * C <- A * B + beta * C
+ *
+ * A is m*k, B is k*n and C is m*n. When 'beta' is 0 the old content
+ * of C is never read, so C may be uninitialized.
+ */
+void gemm( int m, int n, int k,
+	   const double *A, int lda,
+	   const double *B, int ldb,
+	   double beta, double *C, int ldc );
+
+/**
+ * Same in single precision.
+ */
+void gemm_s( int m, int n, int k,
+	     const float *A, int lda,
+	     const float *B, int ldb,
+	     float beta, float *C, int ldc );
+
+/**
+ * Mixed precision: float A and B, products accumulated in double into
+ * a double C.
+ */
+void gemm_sd( int m, int n, int k,
+	      const float *A, int lda,
+	      const float *B, int ldb,
+	      double beta, double *C, int ldc );
+
+/**
+ * Name of the micro-kernel selected for this CPU
+ * ("generic", "sse2", "avx2" or "avx512") by gemm(), gemm_s() and
+ * gemm_sd() respectively. gemm_sd() uses the double kernels.
+ */
+const char *gemm_kernel_name( void );
+const char *gemm_kernel_name_s( void );
+const char *gemm_kernel_name_sd( void );
+
+#endif
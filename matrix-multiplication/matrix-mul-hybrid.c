@@ -1,22 +1,24 @@
 /**
- * Matrix (N*N) multiplication with a single thread.
+ * Matrix (N*N) multiplication with MPI ranks and OpenMP threads per rank.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/time.h>
 #include "mpi.h"
 #include "omp.h"
+#include "matrix-type.h"
 
 #define TAG 10
 #define DEBUG 0
+#define TILE 128 // rows and columns of 'matrix3' in one OpenMP task
 
-double ** allocate_matrix( int size )
+elem_t ** allocate_matrix( int size )
 {
-  /* Allocate 'size' * 'size' doubles contiguously. */
-  double * vals = (double *) malloc( size * size * sizeof(double) );
+  /* Allocate 'size' * 'size' elements contiguously. */
+  elem_t * vals = (elem_t *) malloc( size * size * sizeof(elem_t) );
 
-  /* Allocate array of double* with size 'size' */
-  double ** ptrs = (double **) malloc( size * sizeof(double*) );
+  /* Allocate array of elem_t* with size 'size' */
+  elem_t ** ptrs = (elem_t **) malloc( size * sizeof(elem_t*) );
 
   int i;
   for (i = 0; i < size; ++i) {
@@ -26,7 +28,23 @@ double ** allocate_matrix( int size )
   return ptrs;
 }
 
-void init_matrix( double **matrix, int size )
+result_t ** allocate_result( int size )
+{
+  /* Allocate 'size' * 'size' elements contiguously. */
+  result_t * vals = (result_t *) malloc( size * size * sizeof(result_t) );
+
+  /* Allocate array of result_t* with size 'size' */
+  result_t ** ptrs = (result_t **) malloc( size * sizeof(result_t*) );
+
+  int i;
+  for (i = 0; i < size; ++i) {
+    ptrs[ i ] = &vals[ i * size ];
+  }
+
+  return ptrs;
+}
+
+void init_matrix( elem_t **matrix, int size )
 {
   int i, j;
 
@@ -37,15 +55,28 @@ void init_matrix( double **matrix, int size )
   }
 }
 
-void print_matrix( double **matrix, int size )
+void print_matrix( elem_t **matrix, int size )
+{
+  int i, j;
+
+  for (i = 0; i < size; ++i) {
+    for (j = 0; j < size-1; ++j) {
+      printf( "%lf, ", (double) matrix[ i ][ j ] );
+    }
+    printf( "%lf", (double) matrix[ i ][ j ] );
+    putchar( '\n' );
+  }
+}
+
+void print_result( result_t **matrix, int size )
 {
   int i, j;
 
   for (i = 0; i < size; ++i) {
     for (j = 0; j < size-1; ++j) {
-      printf( "%lf, ", matrix[ i ][ j ] );
+      printf( "%lf, ", (double) matrix[ i ][ j ] );
     }
-    printf( "%lf", matrix[ i ][ j ] );
+    printf( "%lf", (double) matrix[ i ][ j ] );
     putchar( '\n' );
   }
 }
@@ -56,9 +87,10 @@ void print_matrix( double **matrix, int size )
  */
 int main( int argc, char *argv[] )
 {
-  double **matrix1, **matrix2, **matrix3, *tmp;
-  int size, i, j, k, myrank, numtasks, stripsize, chunksize, numthreads;
-  double sum = 0, start_time, end_time;
+  elem_t **matrix1, **matrix2, *tmp1;
+  result_t **matrix3, *tmp3;
+  int size, i, myrank, numtasks, stripsize, numthreads, tiles_m, tiles_n, ti, tj;
+  double start_time, end_time;
 
   if (argc != 3) {
     fprintf( stderr, "%s <matrix size> <numthreads>\n", argv[0] );
@@ -67,6 +99,7 @@ int main( int argc, char *argv[] )
 
   size = atoi( argv[1] );
   numthreads = atoi( argv[2] );
+  omp_set_dynamic( 0 ); // disable dynamic adjustment
   omp_set_num_threads( numthreads );
 
   MPI_Init( &argc, &argv );
@@ -82,22 +115,22 @@ int main( int argc, char *argv[] )
 
   if ( myrank == 0 ) { // rank 0 allocate the entire matrix1 and matrix3
     matrix1 = allocate_matrix( size );
-    matrix3 = allocate_matrix( size );
+    matrix3 = allocate_result( size );
   
     init_matrix( matrix1, size ); // rank 0 initialize matrix 1
   } else {
     /* Allocate strip of matrix 1 other ranks need. */
-    tmp = (double *) malloc( size * stripsize * sizeof(double) );
-    matrix1 = (double **) malloc( stripsize * sizeof(double *) );
+    tmp1 = (elem_t *) malloc( size * stripsize * sizeof(elem_t) );
+    matrix1 = (elem_t **) malloc( stripsize * sizeof(elem_t *) );
     for (i = 0; i < stripsize; ++i) {
-      matrix1[ i ] = &( tmp[i * size] );
+      matrix1[ i ] = &( tmp1[i * size] );
     }
 
     /* Allocate strip of matrix 3 other ranks need. */
-    tmp = (double *) malloc( size * stripsize * sizeof(double) );
-    matrix3 = (double **) malloc( stripsize * sizeof(double *) );
+    tmp3 = (result_t *) malloc( size * stripsize * sizeof(result_t) );
+    matrix3 = (result_t **) malloc( stripsize * sizeof(result_t *) );
     for (i = 0; i < stripsize; ++i) {
-      matrix3[ i ] = &( tmp[i * size] );
+      matrix3[ i ] = &( tmp3[i * size] );
     }
   }
 
@@ -114,21 +147,21 @@ int main( int argc, char *argv[] )
   if (myrank == 0) {
     /* rank 0 dispatch values of strip of matrix1 to other ranks. */
     for ( i = 1; i < numtasks; ++i ) {
-      MPI_Send( matrix1[i*stripsize], stripsize * size, MPI_DOUBLE, i, TAG, MPI_COMM_WORLD );
+      MPI_Send( matrix1[i*stripsize], stripsize * size, MPI_ELEM, i, TAG, MPI_COMM_WORLD );
 #if DEBUG
       printf( "Sending to rank %d done!\n", i );
 #endif
     }
   } else {
     // recevie strip from rank 0.
-    MPI_Recv( matrix1[0], stripsize * size, MPI_DOUBLE, 0, TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
+    MPI_Recv( matrix1[0], stripsize * size, MPI_ELEM, 0, TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
 #if DEBUG
     printf( "rank %d received strip from rank 0 done!\n", myrank );
 #endif
   }
 
   // Broadcast values of 'matrix2' from rank 0 to all other ranks.
-  MPI_Bcast( matrix2[0], size*size, MPI_DOUBLE, 0, MPI_COMM_WORLD );
+  MPI_Bcast( matrix2[0], size*size, MPI_ELEM, 0, MPI_COMM_WORLD );
 
   if ( myrank == 0 && size <= 10 ) {
       printf( "Matrix 1:\n" );
@@ -137,24 +170,25 @@ int main( int argc, char *argv[] )
       print_matrix( matrix2, size );
     }
 
-  chunksize = 20;
-#pragma parallel for shared(matrix1, matrix2, matrix3, chunksize) \
-  private(i, j, k, sum) schedule(static, chunksize)
-  for (i = 0; i < stripsize; ++i) { // hold row index of 'matrix1'
-    for (j = 0; j < size; ++j) { // hold column index of 'matrix2'
-      sum = 0; // hold value of a cell
-      /* one pass to sum the multiplications of corresponding cells
-	 in the row vector and column vector. */
-      for (k = 0; k < size; ++k) { 
-	sum += matrix1[ i ][ k ] * matrix2[ k ][ j ];
-      }
-      matrix3[ i ][ j ] = sum;
+  /* Split the strip into TILE x TILE cache tiles of 'matrix3' and let
+     the OpenMP team of this rank pick them up dynamically. */
+  tiles_m = (stripsize + TILE - 1) / TILE;
+  tiles_n = (size + TILE - 1) / TILE;
+#pragma omp parallel for shared(matrix1, matrix2, matrix3, tiles_m, tiles_n) \
+  private(ti, tj) collapse(2) schedule(dynamic)
+  for (ti = 0; ti < tiles_m; ++ti) {
+    for (tj = 0; tj < tiles_n; ++tj) {
+      int row_start = ti * TILE, col_start = tj * TILE;
+      int rows = ( stripsize - row_start < TILE )? stripsize - row_start : TILE;
+      int cols = ( size - col_start < TILE )? size - col_start : TILE;
+      matrix_gemm( rows, cols, size, matrix1[row_start], size, &matrix2[0][col_start], size,
+		   0.0, &matrix3[row_start][col_start], size );
     }
   }
 
   if ( myrank != 0 ) {
     // send strip of matrix3 to rank 0
-    MPI_Send( matrix3[0], stripsize * size, MPI_DOUBLE, 0, TAG, MPI_COMM_WORLD );
+    MPI_Send( matrix3[0], stripsize * size, MPI_RESULT, 0, TAG, MPI_COMM_WORLD );
 #if DEBUG
     printf( "rank %d has sent strip of matrix3 to rank 0. Done!\n", myrank );
 #endif
@@ -162,7 +196,7 @@ int main( int argc, char *argv[] )
 
   if ( myrank == 0 ) {
     for (i = 1; i < numtasks; ++i) {
-      MPI_Recv( matrix3[i*stripsize], stripsize * size, MPI_DOUBLE, i, TAG, MPI_COMM_WORLD,  MPI_STATUS_IGNORE );
+      MPI_Recv( matrix3[i*stripsize], stripsize * size, MPI_RESULT, i, TAG, MPI_COMM_WORLD,  MPI_STATUS_IGNORE );
 #if DEBUG
       printf( "rank 0 received strip of matrix3 from rank %d done!\n", i );
 #endif
@@ -171,13 +205,13 @@ int main( int argc, char *argv[] )
 
   if ( myrank ==0 && size <= 10 ) {
     printf( "Matrix 3:\n" );
-    print_matrix( matrix3, size );
+    print_result( matrix3, size );
   }
 
   if ( myrank == 0 ) {
     end_time = MPI_Wtime();
-    printf( "Number of MPI ranks: %d\tNumber of threads: 0\tExecution time: %lf sec\n",
-	    numtasks, end_time-start_time);
+    printf( "Number of MPI ranks: %d\tNumber of threads: %d\tExecution time: %lf sec\n",
+	    numtasks, numthreads, end_time-start_time);
   }
 
   MPI_Finalize();
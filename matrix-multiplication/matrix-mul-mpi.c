@@ -1,21 +1,24 @@
 /**
- * Matrix (N*N) multiplication with a single thread.
+ * Matrix (N*N) multiplication with MPI ranks, one strip of rows per rank.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/time.h>
 #include "mpi.h"
+#include "matrix-type.h"
 
 #define TAG 10
 #define DEBUG 1
+#define PANEL GEMM_KC // rows of 'matrix2' in one broadcast panel
+#define ROWS_PER_TEST 256 // rows multiplied between two MPI_Test
 
-double ** allocate_matrix( int size )
+elem_t ** allocate_matrix( int size )
 {
-  /* Allocate 'size' * 'size' doubles contiguously. */
-  double * vals = (double *) malloc( size * size * sizeof(double) );
+  /* Allocate 'size' * 'size' elements contiguously. */
+  elem_t * vals = (elem_t *) malloc( size * size * sizeof(elem_t) );
 
-  /* Allocate array of double* with size 'size' */
-  double ** ptrs = (double **) malloc( size * sizeof(double*) );
+  /* Allocate array of elem_t* with size 'size' */
+  elem_t ** ptrs = (elem_t **) malloc( size * sizeof(elem_t*) );
 
   int i;
   for (i = 0; i < size; ++i) {
@@ -25,7 +28,23 @@ double ** allocate_matrix( int size )
   return ptrs;
 }
 
-void init_matrix( double **matrix, int size )
+result_t ** allocate_result( int size )
+{
+  /* Allocate 'size' * 'size' elements contiguously. */
+  result_t * vals = (result_t *) malloc( size * size * sizeof(result_t) );
+
+  /* Allocate array of result_t* with size 'size' */
+  result_t ** ptrs = (result_t **) malloc( size * sizeof(result_t*) );
+
+  int i;
+  for (i = 0; i < size; ++i) {
+    ptrs[ i ] = &vals[ i * size ];
+  }
+
+  return ptrs;
+}
+
+void init_matrix( elem_t **matrix, int size )
 {
   int i, j;
 
@@ -36,28 +55,63 @@ void init_matrix( double **matrix, int size )
   }
 }
 
-void print_matrix( double **matrix, int size )
+void print_matrix( elem_t **matrix, int size )
+{
+  int i, j;
+
+  for (i = 0; i < size; ++i) {
+    for (j = 0; j < size-1; ++j) {
+      printf( "%lf, ", (double) matrix[ i ][ j ] );
+    }
+    printf( "%lf", (double) matrix[ i ][ j ] );
+    putchar( '\n' );
+  }
+}
+
+void print_result( result_t **matrix, int size )
 {
   int i, j;
 
   for (i = 0; i < size; ++i) {
     for (j = 0; j < size-1; ++j) {
-      printf( "%lf, ", matrix[ i ][ j ] );
+      printf( "%lf, ", (double) matrix[ i ][ j ] );
     }
-    printf( "%lf", matrix[ i ][ j ] );
+    printf( "%lf", (double) matrix[ i ][ j ] );
     putchar( '\n' );
   }
 }
 
+elem_t **matrix2; // the whole 'matrix2', on rank 0 only
+elem_t *panel[2]; // double buffered panels of 'matrix2' on the other ranks
+int size, myrank;
+
+/*
+ * Start broadcasting rows [k0, k0+width) of 'matrix2' from rank 0 into
+ * panel buffer 'buf'. Rank 0 sends straight out of 'matrix2'.
+ */
+void post_panel( int k0, int width, int buf, MPI_Request *request )
+{
+  elem_t *rows = ( myrank == 0 )? matrix2[ k0 ] : panel[ buf ];
+
+  MPI_Ibcast( rows, width * size, MPI_ELEM, 0, MPI_COMM_WORLD, request );
+}
+
 /**
  * Calculate:
  * matrix3 <- matrix1 * matrix2
  */
 int main( int argc, char *argv[] )
 {
-  double **matrix1, **matrix2, **matrix3, *tmp;
-  int size, i, j, k, myrank, numtasks, stripsize;
-  double sum = 0, start_time, end_time;
+  elem_t **matrix1, *tmp1;
+  result_t **matrix3, *tmp3;
+  int i, numtasks, stripsize;
+  int *counts, *displs; // number and offset of the elements of each rank's strip
+  double start_time = 0.0, end_time = 0.0;
+  int k0, width, next_k0, next_width, step, cur, flag;
+  elem_t *b;
+  MPI_Request request;
+  double phase_time[3], max_phase_time[3]; // distribution, compute (with the
+					   // broadcast of 'matrix2'), gather
 
   if (argc != 2) {
     fprintf( stderr, "%s <matrix size>\n", argv[0] );
@@ -70,62 +124,74 @@ int main( int argc, char *argv[] )
   MPI_Comm_size( MPI_COMM_WORLD, &numtasks );
   MPI_Comm_rank( MPI_COMM_WORLD, &myrank );
 
-  if ( myrank == 0 && size % numtasks != 0 ) {
-    fprintf( stderr, "size %d must be a multiple of number of tasks %d\n", size, numtasks );
+  if ( myrank == 0 && size < numtasks ) {
+    fprintf( stderr, "size %d must be at least the number of tasks %d\n", size, numtasks );
     MPI_Abort( MPI_COMM_WORLD, -1 );
   }
 
-  stripsize = size / numtasks; // the size of the strip each rank works on.
+  /* Rank i works on rows [i*size/numtasks, (i+1)*size/numtasks), so the
+     strips differ by at most one row when size is not a multiple of
+     numtasks. */
+  counts = (int *) malloc( numtasks * sizeof(int) );
+  displs = (int *) malloc( numtasks * sizeof(int) );
+  for (i = 0; i < numtasks; ++i) {
+    int first = (int) ((long) size * i / numtasks);
+    int last = (int) ((long) size * (i+1) / numtasks);
+    counts[ i ] = (last - first) * size;
+    displs[ i ] = first * size;
+  }
+  stripsize = counts[ myrank ] / size; // the size of the strip each rank works on.
 
   if ( myrank == 0 ) { // rank 0 allocate the entire matrix1 and matrix3
     matrix1 = allocate_matrix( size );
-    matrix3 = allocate_matrix( size );
+    matrix3 = allocate_result( size );
   
     init_matrix( matrix1, size ); // rank 0 initialize matrix 1
   } else {
     /* Allocate strip of matrix 1 other ranks need. */
-    tmp = (double *) malloc( size * stripsize * sizeof(double) );
-    matrix1 = (double **) malloc( stripsize * sizeof(double *) );
+    tmp1 = (elem_t *) malloc( size * stripsize * sizeof(elem_t) );
+    matrix1 = (elem_t **) malloc( stripsize * sizeof(elem_t *) );
     for (i = 0; i < stripsize; ++i) {
-      matrix1[ i ] = &( tmp[i * size] );
+      matrix1[ i ] = &( tmp1[i * size] );
     }
 
     /* Allocate strip of matrix 3 other ranks need. */
-    tmp = (double *) malloc( size * stripsize * sizeof(double) );
-    matrix3 = (double **) malloc( stripsize * sizeof(double *) );
+    tmp3 = (result_t *) malloc( size * stripsize * sizeof(result_t) );
+    matrix3 = (result_t **) malloc( stripsize * sizeof(result_t *) );
     for (i = 0; i < stripsize; ++i) {
-      matrix3[ i ] = &( tmp[i * size] );
+      matrix3[ i ] = &( tmp3[i * size] );
     }
   }
 
-  /* Every rank allocates the entire 'matrix2' for calculation. */
-  matrix2 = allocate_matrix( size );
+  /* Only rank 0 holds the entire 'matrix2'. The other ranks receive it
+     one panel of PANEL rows at a time into two alternating buffers. */
   if (myrank == 0) { // only rank 0 initialize 'matrix2'.
+    matrix2 = allocate_matrix( size );
     init_matrix( matrix2, size );
+  } else {
+    for (i = 0; i < 2; ++i) {
+      panel[ i ] = (elem_t *) malloc( PANEL * size * sizeof(elem_t) );
+    }
   }
 
   if (myrank == 0) {
     start_time = MPI_Wtime();
   }
 
+  /* Distribution: scatter the strips of 'matrix1' (rank 0 keeps its own
+     strip in place). */
+  phase_time[0] = MPI_Wtime();
   if (myrank == 0) {
-    /* rank 0 dispatch values of strip of matrix1 to other ranks. */
-    for ( i = 1; i < numtasks; ++i ) {
-      MPI_Send( matrix1[i*stripsize], stripsize * size, MPI_DOUBLE, i, TAG, MPI_COMM_WORLD );
-#if DEBUG
-      printf( "Sending to rank %d done!\n", i );
-#endif
-    }
+    MPI_Scatterv( matrix1[0], counts, displs, MPI_ELEM,
+		  MPI_IN_PLACE, counts[0], MPI_ELEM, 0, MPI_COMM_WORLD );
   } else {
-    // recevie strip from rank 0.
-    MPI_Recv( matrix1[0], stripsize * size, MPI_DOUBLE, 0, TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
+    MPI_Scatterv( NULL, counts, displs, MPI_ELEM,
+		  matrix1[0], counts[ myrank ], MPI_ELEM, 0, MPI_COMM_WORLD );
+  }
 #if DEBUG
-    printf( "rank %d received strip from rank 0 done!\n", myrank );
+  printf( "rank %d received %d rows of matrix1 from rank 0\n", myrank, stripsize );
 #endif
-  }
-
-  // Broadcast values of 'matrix2' from rank 0 to all other ranks.
-  MPI_Bcast( matrix2[0], size*size, MPI_DOUBLE, 0, MPI_COMM_WORLD );
+  phase_time[0] = MPI_Wtime() - phase_time[0];
 
   if ( myrank == 0 && size <= 10 ) {
       printf( "Matrix 1:\n" );
@@ -134,44 +200,62 @@ int main( int argc, char *argv[] )
       print_matrix( matrix2, size );
     }
 
-  for (i = 0; i < stripsize; ++i) { // hold row index of 'matrix1'
-    for (j = 0; j < size; ++j) { // hold column index of 'matrix2'
-      sum = 0; // hold value of a cell
-      /* one pass to sum the multiplications of corresponding cells
-	 in the row vector and column vector. */
-      for (k = 0; k < size; ++k) { 
-	sum += matrix1[ i ][ k ] * matrix2[ k ][ j ];
-      }
-      matrix3[ i ][ j ] = sum;
+  /* Compute: broadcast 'matrix2' panel by panel and multiply each one
+     with the matching columns of my strip of 'matrix1' while the next
+     panel is already on its way. */
+  phase_time[1] = MPI_Wtime();
+  width = ( size < PANEL )? size : PANEL;
+  post_panel( 0, width, 0, &request );
+  for (k0 = 0, step = 0; k0 < size; k0 = next_k0, width = next_width, ++step) {
+    cur = step % 2;
+    MPI_Wait( &request, MPI_STATUS_IGNORE );
+    b = ( myrank == 0 )? matrix2[ k0 ] : panel[ cur ];
+
+    next_k0 = k0 + width;
+    next_width = ( size - next_k0 < PANEL )? size - next_k0 : PANEL;
+    if (next_k0 < size)
+      post_panel( next_k0, next_width, 1 - cur, &request );
+
+    /* matrix3 += matrix1[:, k0:k0+width] * panel, a few rows at a time
+       so that MPI gets a chance to progress the broadcast in flight. */
+    for (i = 0; i < stripsize; i += ROWS_PER_TEST) {
+      int rows = ( stripsize - i < ROWS_PER_TEST )? stripsize - i : ROWS_PER_TEST;
+      matrix_gemm( rows, size, width, &matrix1[i][k0], size, b, size,
+		   ( step == 0 )? 0.0 : 1.0, matrix3[i], size );
+      if (next_k0 < size)
+	MPI_Test( &request, &flag, MPI_STATUS_IGNORE );
     }
   }
+  phase_time[1] = MPI_Wtime() - phase_time[1];
 
-  if ( myrank != 0 ) {
-    // send strip of matrix3 to rank 0
-    MPI_Send( matrix3[0], stripsize * size, MPI_DOUBLE, 0, TAG, MPI_COMM_WORLD );
-#if DEBUG
-    printf( "rank %d has sent strip of matrix3 to rank 0. Done!\n", myrank );
-#endif
+  /* Gather: collect the strips of 'matrix3' on rank 0. */
+  phase_time[2] = MPI_Wtime();
+  if (myrank == 0) {
+    MPI_Gatherv( MPI_IN_PLACE, counts[0], MPI_RESULT,
+		 matrix3[0], counts, displs, MPI_RESULT, 0, MPI_COMM_WORLD );
+  } else {
+    MPI_Gatherv( matrix3[0], counts[ myrank ], MPI_RESULT,
+		 NULL, counts, displs, MPI_RESULT, 0, MPI_COMM_WORLD );
   }
-
-  if ( myrank == 0 ) {
-    for (i = 1; i < numtasks; ++i) {
-      MPI_Recv( matrix3[i*stripsize], stripsize * size, MPI_DOUBLE, i, TAG, MPI_COMM_WORLD,  MPI_STATUS_IGNORE );
 #if DEBUG
-      printf( "rank 0 received strip of matrix3 from rank %d done!\n", i );
+  printf( "rank %d has sent %d rows of matrix3 to rank 0\n", myrank, stripsize );
 #endif
-    }
-  }
+  phase_time[2] = MPI_Wtime() - phase_time[2];
 
   if ( myrank ==0 && size <= 10 ) {
     printf( "Matrix 3:\n" );
-    print_matrix( matrix3, size );
+    print_result( matrix3, size );
   }
 
+  /* Report the slowest rank for every phase. */
+  MPI_Reduce( phase_time, max_phase_time, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD );
+
   if ( myrank == 0 ) {
     end_time = MPI_Wtime();
-    printf( "Number of MPI ranks: %d\tNumber of threads: 0\tExecution time: %lf sec\n",
-	    numtasks, end_time-start_time);
+    printf( "Number of MPI ranks: %d\tNumber of threads: 0\tExecution time: %lf sec\t"
+	    "Distribution: %lf sec\tCompute: %lf sec\tGather: %lf sec\n",
+	    numtasks, end_time-start_time,
+	    max_phase_time[0], max_phase_time[1], max_phase_time[2] );
   }
 
   MPI_Finalize();
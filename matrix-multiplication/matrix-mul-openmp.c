@@ -3,16 +3,20 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
+#include <unistd.h>
 #include "omp.h"
+#include "matrix-type.h"
+#include "matrix-place.h"
 
-double ** allocate_matrix( int size )
+elem_t ** allocate_matrix( int size )
 {
-  /* Allocate 'size' * 'size' doubles contiguously. */
-  double * vals = (double *) malloc( size * size * sizeof(double) );
+  /* Allocate 'size' * 'size' elements contiguously. */
+  elem_t * vals = (elem_t *) malloc( size * size * sizeof(elem_t) );
 
-  /* Allocate array of double* with size 'size' */
-  double ** ptrs = (double **) malloc( size * sizeof(double*) );
+  /* Allocate array of elem_t* with size 'size' */
+  elem_t ** ptrs = (elem_t **) malloc( size * sizeof(elem_t*) );
 
   int i;
   for (i = 0; i < size; ++i) {
@@ -22,45 +26,91 @@ double ** allocate_matrix( int size )
   return ptrs;
 }
 
-void init_matrix( double **matrix, int size )
+result_t ** allocate_result( int size )
 {
-  int i, j;
+  /* Allocate 'size' * 'size' elements contiguously. */
+  result_t * vals = (result_t *) malloc( size * size * sizeof(result_t) );
+
+  /* Allocate array of result_t* with size 'size' */
+  result_t ** ptrs = (result_t **) malloc( size * sizeof(result_t*) );
 
+  int i;
   for (i = 0; i < size; ++i) {
+    ptrs[ i ] = &vals[ i * size ];
+  }
+
+  return ptrs;
+}
+
+void init_matrix( elem_t **matrix, int first, int last, int size )
+{
+  int i, j;
+
+  for (i = first; i < last; ++i) {
     for (j = 0; j < size; ++j) {
       matrix[ i ][ j ] = 1.0;
     }
   }
 }
 
-void print_matrix( double **matrix, int size )
+void print_matrix( elem_t **matrix, int size )
 {
   int i, j;
 
   for (i = 0; i < size; ++i) {
     for (j = 0; j < size-1; ++j) {
-      printf( "%lf, ", matrix[ i ][ j ] );
+      printf( "%lf, ", (double) matrix[ i ][ j ] );
     }
-    printf( "%lf", matrix[ i ][ j ] );
+    printf( "%lf", (double) matrix[ i ][ j ] );
+    putchar( '\n' );
+  }
+}
+
+void print_result( result_t **matrix, int size )
+{
+  int i, j;
+
+  for (i = 0; i < size; ++i) {
+    for (j = 0; j < size-1; ++j) {
+      printf( "%lf, ", (double) matrix[ i ][ j ] );
+    }
+    printf( "%lf", (double) matrix[ i ][ j ] );
     putchar( '\n' );
   }
 }
 
 int main( int argc, char *argv[] )
 {
-  double **matrix1, **matrix2, **matrix3;
-  int size, i, j, k, chunksize, numthreads;
-  double sum = 0;
+  elem_t **matrix1, **matrix2;
+  result_t **matrix3;
+  int size, i, j, chunksize, numthreads, opt, interleave = 0;
   struct timeval tstart, tend;
   double exectime;
 
-  if (argc != 3) {
-    fprintf( stderr, "%s <matrix size> <number of thread>\n", argv[0] );
+  while ((opt = getopt( argc, argv, "p:i" )) != -1) {
+    switch (opt) {
+    case 'p':
+      if (place_cpus( optarg ) < 0)
+	argc = 0;
+      break;
+    case 'i':
+      interleave = 1;
+      break;
+    default:
+      argc = 0; // print the usage below
+    }
+  }
+
+  if (argc - optind != 2) {
+    fprintf( stderr, "%s [-p cpus] [-i] <matrix size> <number of thread>\n", argv[0] );
+    fprintf( stderr, "  -p  pin thread k to the k-th CPU of 'cpus', e.g. 0-7 or 0,2,4,6\n" );
+    fprintf( stderr, "  -i  interleave matrix 2, which every thread reads, over all NUMA nodes\n"
+	     "      (needs make NUMA=1)\n" );
     return -1;
   }
 
-  size = atoi( argv[1] );
-  numthreads = atoi( argv[2] );
+  size = atoi( argv[optind] );
+  numthreads = atoi( argv[optind+1] );
 
   if (size % numthreads != 0) {
     fprintf( stderr, "matrix size %d must be a multiple of number of threads %d!\n",
@@ -72,10 +122,25 @@ int main( int argc, char *argv[] )
 
   matrix1 = allocate_matrix( size );
   matrix2 = allocate_matrix( size );
-  matrix3 = allocate_matrix( size );
-  
-  init_matrix( matrix1, size );
-  init_matrix( matrix2, size );
+  matrix3 = allocate_result( size );
+  if (interleave && place_interleave( matrix2[0], (size_t) size * size * sizeof(elem_t) ) != 0) {
+    fprintf( stderr, "-i needs libnuma and a NUMA kernel (make NUMA=1)\n" );
+    return -1;
+  }
+
+  /* Every thread pins itself (libgomp reads OMP_PLACES before main(), so
+     -p is done by hand) and initializes the strips it multiplies below,
+     so that they are placed on its NUMA node. */
+#pragma omp parallel for shared(matrix1, matrix2, matrix3, chunksize) \
+  private(i, j) schedule(static, 1)
+  for (i = 0; i < numthreads; ++i) {
+    place_pin( omp_get_thread_num() );
+    init_matrix( matrix1, i*chunksize, (i+1)*chunksize, size );
+    init_matrix( matrix2, i*chunksize, (i+1)*chunksize, size );
+    for (j = i*chunksize; j < (i+1)*chunksize; ++j) {
+      memset( matrix3[ j ], 0, size * sizeof(result_t) );
+    }
+  }
 
   if ( size <= 10 ) {
     printf( "Matrix 1:\n" );
@@ -86,24 +151,19 @@ int main( int argc, char *argv[] )
 
   gettimeofday( &tstart, NULL );
   
+  /* Each thread multiplies its own strip of 'chunksize' rows with the
+     blocked kernel. */
 #pragma omp parallel for shared(matrix1, matrix2, matrix3, chunksize) \
-  private(i,j,k,sum) schedule(static, chunksize)
-  for (i = 0; i < size; ++i) { // hold row index of 'matrix1'
-    for (j = 0; j < size; ++j) { // hold column index of 'matrix2'
-      sum = 0; // hold value of a cell
-      /* one pass to sum the multiplications of corresponding cells
-	 in the row vector and column vector. */
-      for (k = 0; k < size; ++k) { 
-	sum += matrix1[ i ][ k ] * matrix2[ k ][ j ];
-      }
-      matrix3[ i ][ j ] = sum;
-    }
+  private(i) schedule(static, 1)
+  for (i = 0; i < numthreads; ++i) {
+    matrix_gemm( chunksize, size, size, matrix1[i*chunksize], size, matrix2[0], size,
+		 0.0, matrix3[i*chunksize], size );
   }
   gettimeofday( &tend, NULL );
   
   if ( size <= 10 ) {
     printf( "Matrix 3:\n" );
-    print_matrix( matrix3, size );
+    print_result( matrix3, size );
   }
 
   exectime = (tend.tv_sec - tstart.tv_sec) * 1000.0; // sec to ms
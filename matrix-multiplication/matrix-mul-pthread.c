@@ -5,17 +5,22 @@
 #include <stdlib.h>
 #include <sys/time.h>
 #include <pthread.h>
+#include <unistd.h>
+#include "matrix-type.h"
+#include "matrix-place.h"
 
 int size, num_threads;
-double **matrix1, **matrix2, **matrix3;
+int interleave = 0; // spread matrix 2 over all NUMA nodes (matrix-place.h)
+elem_t **matrix1, **matrix2;
+result_t **matrix3;
 
-double ** allocate_matrix( int size )
+elem_t ** allocate_matrix( int size )
 {
-  /* Allocate 'size' * 'size' doubles contiguously. */
-  double * vals = (double *) malloc( size * size * sizeof(double) );
+  /* Allocate 'size' * 'size' elements contiguously. */
+  elem_t * vals = (elem_t *) malloc( size * size * sizeof(elem_t) );
 
-  /* Allocate array of double* with size 'size' */
-  double ** ptrs = (double **) malloc( size * sizeof(double*) );
+  /* Allocate array of elem_t* with size 'size' */
+  elem_t ** ptrs = (elem_t **) malloc( size * sizeof(elem_t*) );
 
   int i;
   for (i = 0; i < size; ++i) {
@@ -25,89 +30,315 @@ double ** allocate_matrix( int size )
   return ptrs;
 }
 
-void init_matrix( double **matrix, int size )
+result_t ** allocate_result( int size )
 {
-  int i, j;
+  /* Allocate 'size' * 'size' elements contiguously. */
+  result_t * vals = (result_t *) malloc( size * size * sizeof(result_t) );
+
+  /* Allocate array of result_t* with size 'size' */
+  result_t ** ptrs = (result_t **) malloc( size * sizeof(result_t*) );
 
+  int i;
   for (i = 0; i < size; ++i) {
+    ptrs[ i ] = &vals[ i * size ];
+  }
+
+  return ptrs;
+}
+
+/*
+ * Initialize rows [first, last) of the three matrices (matrix 3 with 0).
+ */
+void init_rows( int first, int last )
+{
+  int i, j;
+
+  for (i = first; i < last; ++i) {
     for (j = 0; j < size; ++j) {
-      matrix[ i ][ j ] = 1.0;
+      matrix1[ i ][ j ] = 1.0;
+      matrix2[ i ][ j ] = 1.0;
+      matrix3[ i ][ j ] = 0.0;
+    }
+  }
+}
+
+void print_matrix( elem_t **matrix, int size )
+{
+  int i, j;
+
+  for (i = 0; i < size; ++i) {
+    for (j = 0; j < size-1; ++j) {
+      printf( "%lf, ", (double) matrix[ i ][ j ] );
     }
+    printf( "%lf", (double) matrix[ i ][ j ] );
+    putchar( '\n' );
   }
 }
 
-void print_matrix( double **matrix, int size )
+void print_result( result_t **matrix, int size )
 {
   int i, j;
 
   for (i = 0; i < size; ++i) {
     for (j = 0; j < size-1; ++j) {
-      printf( "%lf, ", matrix[ i ][ j ] );
+      printf( "%lf, ", (double) matrix[ i ][ j ] );
     }
-    printf( "%lf", matrix[ i ][ j ] );
+    printf( "%lf", (double) matrix[ i ][ j ] );
     putchar( '\n' );
   }
 }
 
+/**
+ * Work-stealing thread pool.
+ *
+ * The output matrix is cut into TILE x TILE tiles. Every thread owns a
+ * deque of tile indices, seeded with a contiguous range of tiles. The
+ * owner takes tiles from the bottom of its own deque; a thread whose
+ * deque is empty steals from the top of the others, so a thread slowed
+ * down by another job on its core simply ends up doing fewer tiles.
+ * The threads are created once and sleep on 'work_ready' between jobs.
+ */
+#define TILE 128
+
+typedef struct {
+  pthread_mutex_t lock;
+  int *tiles; // tile indices, valid between 'top' and 'bottom'
+  int top;    // next tile a thief steals
+  int bottom; // one past the next tile the owner takes
+} deque_t;
+
+deque_t *deques;
+pthread_t *threads;
+pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+pthread_cond_t work_done = PTHREAD_COND_INITIALIZER;
+int generation = 0; // bumped every time a new multiplication is posted
+int busy_threads = 0; // threads still working on the current job
+int shutdown_pool = 0;
+int tiles_m, tiles_n; // number of tiles along the rows and columns of C
+
+/*
+ * Take a tile from the bottom of our own deque, -1 if it is empty.
+ */
+int pop_tile( int id )
+{
+  deque_t *dq = &deques[ id ];
+  int tile = -1;
+
+  pthread_mutex_lock( &dq->lock );
+  if (dq->top < dq->bottom) {
+    tile = dq->tiles[ --dq->bottom ];
+  }
+  pthread_mutex_unlock( &dq->lock );
+  return tile;
+}
+
+/*
+ * Steal a tile from the top of another thread's deque, -1 if every
+ * deque is empty.
+ */
+int steal_tile( int id )
+{
+  int i, victim, tile;
+
+  for (i = 1; i < num_threads; ++i) {
+    victim = (id + i) % num_threads;
+    deque_t *dq = &deques[ victim ];
+    tile = -1;
+    pthread_mutex_lock( &dq->lock );
+    if (dq->top < dq->bottom) {
+      tile = dq->tiles[ dq->top++ ];
+    }
+    pthread_mutex_unlock( &dq->lock );
+    if (tile >= 0)
+      return tile;
+  }
+  return -1;
+}
+
+/*
+ * matrix3 tile <- matrix1 rows of the tile * matrix2 columns of the tile
+ */
+void compute_tile( int tile )
+{
+  int row_start = (tile / tiles_n) * TILE;
+  int col_start = (tile % tiles_n) * TILE;
+  int rows = ( size - row_start < TILE )? size - row_start : TILE;
+  int cols = ( size - col_start < TILE )? size - col_start : TILE;
+
+  matrix_gemm( rows, cols, size, matrix1[row_start], size,
+	       &matrix2[0][col_start], size, 0.0, &matrix3[row_start][col_start], size );
+}
+
 /**
  * Thread routine.
- * Each thread works on a portion of the 'matrix1'.
- * The start and end of the portion depend on the 'arg' which
- * is the ID assigned to threads sequentially. 
+ * 'arg' is the ID assigned to threads sequentially. The thread first
+ * pins itself and initializes its share of the rows, which are about
+ * the rows of the tiles its deque is seeded with, so that they are
+ * placed on its NUMA node. Then it waits for a job, drains its own
+ * deque, steals until no tile is left and reports back, until the pool
+ * is shut down.
  */
 void * worker( void *arg )
 {
-  int i, j, k, tid, portion_size, row_start, row_end;
-  double sum;
-  
-  tid = *(int *)(arg); // get the thread ID assigned sequentially.
-  portion_size = size / num_threads;
-  row_start = tid * portion_size;
-  row_end = (tid+1) * portion_size;
-
-  for (i = row_start; i < row_end; ++i) { // hold row index of 'matrix1'
-    for (j = 0; j < size; ++j) { // hold column index of 'matrix2'
-      sum = 0; // hold value of a cell
-      /* one pass to sum the multiplications of corresponding cells
-	 in the row vector and column vector. */
-      for (k = 0; k < size; ++k) { 
-	sum += matrix1[ i ][ k ] * matrix2[ k ][ j ];
-      }
-      matrix3[ i ][ j ] = sum;
+  int id = *(int *)(arg); // get the thread ID assigned sequentially.
+  int seen = 0, tile;
+
+  place_pin( id );
+  init_rows( (int) ((long) size * id / num_threads), (int) ((long) size * (id+1) / num_threads) );
+  pthread_mutex_lock( &pool_lock );
+  if (--busy_threads == 0)
+    pthread_cond_signal( &work_done );
+  pthread_mutex_unlock( &pool_lock );
+
+  for (;;) {
+    pthread_mutex_lock( &pool_lock );
+    while (generation == seen && !shutdown_pool)
+      pthread_cond_wait( &work_ready, &pool_lock );
+    if (shutdown_pool) {
+      pthread_mutex_unlock( &pool_lock );
+      return NULL;
     }
+    seen = generation;
+    pthread_mutex_unlock( &pool_lock );
+
+    while ((tile = pop_tile( id )) >= 0 || (tile = steal_tile( id )) >= 0) {
+      compute_tile( tile );
+    }
+
+    pthread_mutex_lock( &pool_lock );
+    if (--busy_threads == 0)
+      pthread_cond_signal( &work_done );
+    pthread_mutex_unlock( &pool_lock );
   }
 }
 
-int main( int argc, char *argv[] )
+/*
+ * Start the threads and wait until they have initialized the matrices.
+ */
+void pool_start( void )
 {
   int i;
-  double sum = 0;
+
+  threads = (pthread_t *) malloc( num_threads * sizeof(pthread_t) );
+  deques = (deque_t *) malloc( num_threads * sizeof(deque_t) );
+  for ( i = 0; i < num_threads; ++i ) {
+    pthread_mutex_init( &deques[i].lock, NULL );
+    deques[i].tiles = NULL;
+    deques[i].top = deques[i].bottom = 0;
+  }
+
+  busy_threads = num_threads;
+  for ( i = 0; i < num_threads; ++i ) {
+    int *tid;
+    tid = (int *) malloc( sizeof(int) );
+    *tid = i;
+    pthread_create( &threads[i], NULL, worker, (void *)tid );
+  }
+
+  pthread_mutex_lock( &pool_lock );
+  while (busy_threads > 0)
+    pthread_cond_wait( &work_done, &pool_lock );
+  pthread_mutex_unlock( &pool_lock );
+}
+
+/*
+ * matrix3 <- matrix1 * matrix2 on the pool. Returns when every tile
+ * has been computed.
+ */
+void pool_multiply( void )
+{
+  int i, t, num_tiles, first, count;
+
+  tiles_m = (size + TILE - 1) / TILE;
+  tiles_n = (size + TILE - 1) / TILE;
+  num_tiles = tiles_m * tiles_n;
+
+  /* Seed each deque with a contiguous range of tiles (so a thread
+     mostly reuses the same rows of 'matrix1'). */
+  for ( i = 0; i < num_threads; ++i ) {
+    first = (int) ((long) num_tiles * i / num_threads);
+    count = (int) ((long) num_tiles * (i+1) / num_threads) - first;
+    free( deques[i].tiles );
+    deques[i].tiles = (int *) malloc( (count > 0 ? count : 1) * sizeof(int) );
+    /* The owner pops from the bottom, so store the range reversed to
+       walk it in order. */
+    for ( t = 0; t < count; ++t ) {
+      deques[i].tiles[ t ] = first + count - 1 - t;
+    }
+    deques[i].top = 0;
+    deques[i].bottom = count;
+  }
+
+  pthread_mutex_lock( &pool_lock );
+  busy_threads = num_threads;
+  ++generation;
+  pthread_cond_broadcast( &work_ready );
+  while (busy_threads > 0)
+    pthread_cond_wait( &work_done, &pool_lock );
+  pthread_mutex_unlock( &pool_lock );
+}
+
+void pool_stop( void )
+{
+  int i;
+
+  pthread_mutex_lock( &pool_lock );
+  shutdown_pool = 1;
+  pthread_cond_broadcast( &work_ready );
+  pthread_mutex_unlock( &pool_lock );
+
+  for ( i = 0; i < num_threads; ++i ) {
+    pthread_join( threads[i], NULL );
+  }
+}
+
+int main( int argc, char *argv[] )
+{
   struct timeval tstart, tend;
   double exectime;
-  pthread_t * threads;
+  int opt;
 
-  if (argc != 3) {
-    fprintf( stderr, "%s <matrix size> <number of threads>\n", argv[0], argv[1] );
+  while ((opt = getopt( argc, argv, "p:i" )) != -1) {
+    switch (opt) {
+    case 'p':
+      if (place_cpus( optarg ) < 0)
+	argc = 0;
+      break;
+    case 'i':
+      interleave = 1;
+      break;
+    default:
+      argc = 0; // print the usage below
+    }
+  }
+
+  if (argc - optind != 2) {
+    fprintf( stderr, "%s [-p cpus] [-i] <matrix size> <number of threads>\n", argv[0] );
+    fprintf( stderr, "  -p  pin thread k to the k-th CPU of 'cpus', e.g. 0-7 or 0,2,4,6\n" );
+    fprintf( stderr, "  -i  interleave matrix 2, which every thread reads, over all NUMA nodes\n"
+	     "      (needs make NUMA=1)\n" );
     return -1;
   }
 
-  size = atoi( argv[1] );
-  num_threads = atoi( argv[2] );
+  size = atoi( argv[optind] );
+  num_threads = atoi( argv[optind+1] );
 
-  if ( size % num_threads != 0 ) {
-    fprintf( stderr, "size %d must be a multiple of num of threads %d\n",
+  if ( size <= 0 || num_threads <= 0 ) {
+    fprintf( stderr, "size %d and num of threads %d must be positive\n",
 	     size, num_threads );
     return -1;
   }
 
-  threads = (pthread_t *) malloc( num_threads * sizeof(pthread_t) );
-
   matrix1 = allocate_matrix( size );
   matrix2 = allocate_matrix( size );
-  matrix3 = allocate_matrix( size );
-  
-  init_matrix( matrix1, size );
-  init_matrix( matrix2, size );
+  matrix3 = allocate_result( size );
+  if (interleave && place_interleave( matrix2[0], (size_t) size * size * sizeof(elem_t) ) != 0) {
+    fprintf( stderr, "-i needs libnuma and a NUMA kernel (make NUMA=1)\n" );
+    return -1;
+  }
+
+  pool_start(); // also initializes the matrices
 
   if ( size <= 10 ) {
     printf( "Matrix 1:\n" );
@@ -117,21 +348,14 @@ int main( int argc, char *argv[] )
   }
 
   gettimeofday( &tstart, NULL );
-  for ( i = 0; i < num_threads; ++i ) {
-    int *tid;
-    tid = (int *) malloc( sizeof(int) );
-    *tid = i;
-    pthread_create( &threads[i], NULL, worker, (void *)tid );
-  }
-
-  for ( i = 0; i < num_threads; ++i ) {
-    pthread_join( threads[i], NULL );
-  }
+  pool_multiply();
   gettimeofday( &tend, NULL );
+
+  pool_stop();
   
   if ( size <= 10 ) {
     printf( "Matrix 3:\n" );
-    print_matrix( matrix3, size );
+    print_result( matrix3, size );
   }
 
   exectime = (tend.tv_sec - tstart.tv_sec) * 1000.0; // sec to ms
@@ -4,14 +4,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/time.h>
+#include "matrix-type.h"
 
-double ** allocate_matrix( int size )
+elem_t ** allocate_matrix( int size )
 {
-  /* Allocate 'size' * 'size' doubles contiguously. */
-  double * vals = (double *) malloc( size * size * sizeof(double) );
+  /* Allocate 'size' * 'size' elements contiguously. */
+  elem_t * vals = (elem_t *) malloc( size * size * sizeof(elem_t) );
 
-  /* Allocate array of double* with size 'size' */
-  double ** ptrs = (double **) malloc( size * sizeof(double*) );
+  /* Allocate array of elem_t* with size 'size' */
+  elem_t ** ptrs = (elem_t **) malloc( size * sizeof(elem_t*) );
 
   int i;
   for (i = 0; i < size; ++i) {
@@ -21,7 +22,23 @@ double ** allocate_matrix( int size )
   return ptrs;
 }
 
-void init_matrix( double **matrix, int size )
+result_t ** allocate_result( int size )
+{
+  /* Allocate 'size' * 'size' elements contiguously. */
+  result_t * vals = (result_t *) malloc( size * size * sizeof(result_t) );
+
+  /* Allocate array of result_t* with size 'size' */
+  result_t ** ptrs = (result_t **) malloc( size * sizeof(result_t*) );
+
+  int i;
+  for (i = 0; i < size; ++i) {
+    ptrs[ i ] = &vals[ i * size ];
+  }
+
+  return ptrs;
+}
+
+void init_matrix( elem_t **matrix, int size )
 {
   int i, j;
 
@@ -32,24 +49,37 @@ void init_matrix( double **matrix, int size )
   }
 }
 
-void print_matrix( double **matrix, int size )
+void print_matrix( elem_t **matrix, int size )
 {
   int i, j;
 
   for (i = 0; i < size; ++i) {
     for (j = 0; j < size-1; ++j) {
-      printf( "%lf, ", matrix[ i ][ j ] );
+      printf( "%lf, ", (double) matrix[ i ][ j ] );
     }
-    printf( "%lf", matrix[ i ][ j ] );
+    printf( "%lf", (double) matrix[ i ][ j ] );
+    putchar( '\n' );
+  }
+}
+
+void print_result( result_t **matrix, int size )
+{
+  int i, j;
+
+  for (i = 0; i < size; ++i) {
+    for (j = 0; j < size-1; ++j) {
+      printf( "%lf, ", (double) matrix[ i ][ j ] );
+    }
+    printf( "%lf", (double) matrix[ i ][ j ] );
     putchar( '\n' );
   }
 }
 
 int main( int argc, char *argv[] )
 {
-  double **matrix1, **matrix2, **matrix3;
-  int size, i, j, k;
-  double sum = 0;
+  elem_t **matrix1, **matrix2;
+  result_t **matrix3;
+  int size;
   struct timeval tstart, tend;
   double exectime;
 
@@ -62,7 +92,7 @@ int main( int argc, char *argv[] )
 
   matrix1 = allocate_matrix( size );
   matrix2 = allocate_matrix( size );
-  matrix3 = allocate_matrix( size );
+  matrix3 = allocate_result( size );
   
   init_matrix( matrix1, size );
   init_matrix( matrix2, size );
@@ -75,22 +105,13 @@ int main( int argc, char *argv[] )
   }
 
   gettimeofday( &tstart, NULL );
-  for (i = 0; i < size; ++i) { // hold row index of 'matrix1'
-    for (j = 0; j < size; ++j) { // hold column index of 'matrix2'
-      sum = 0; // hold value of a cell
-      /* one pass to sum the multiplications of corresponding cells
-	 in the row vector and column vector. */
-      for (k = 0; k < size; ++k) { 
-	sum += matrix1[ i ][ k ] * matrix2[ k ][ j ];
-      }
-      matrix3[ i ][ j ] = sum;
-    }
-  }
+  matrix_gemm( size, size, size, matrix1[0], size, matrix2[0], size,
+	       0.0, matrix3[0], size );
   gettimeofday( &tend, NULL );
   
   if ( size <= 10 ) {
     printf( "Matrix 3:\n" );
-    print_matrix( matrix3, size );
+    print_result( matrix3, size );
   }
 
   exectime = (tend.tv_sec - tstart.tv_sec) * 1000.0; // sec to ms
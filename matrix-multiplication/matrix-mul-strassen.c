@@ -0,0 +1,104 @@
+/**
+ * Matrix (N*N) multiplication with Strassen-Winograd and Open MP tasks.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "omp.h"
+#include "strassen.h"
+
+double ** allocate_matrix( int size )
+{
+  /* Allocate 'size' * 'size' doubles contiguously. */
+  double * vals = (double *) malloc( size * size * sizeof(double) );
+
+  /* Allocate array of double* with size 'size' */
+  double ** ptrs = (double **) malloc( size * sizeof(double*) );
+
+  int i;
+  for (i = 0; i < size; ++i) {
+    ptrs[ i ] = &vals[ i * size ];
+  }
+
+  return ptrs;
+}
+
+void init_matrix( double **matrix, int size )
+{
+  int i, j;
+
+  for (i = 0; i < size; ++i) {
+    for (j = 0; j < size; ++j) {
+      matrix[ i ][ j ] = 1.0;
+    }
+  }
+}
+
+void print_matrix( double **matrix, int size )
+{
+  int i, j;
+
+  for (i = 0; i < size; ++i) {
+    for (j = 0; j < size-1; ++j) {
+      printf( "%lf, ", matrix[ i ][ j ] );
+    }
+    printf( "%lf", matrix[ i ][ j ] );
+    putchar( '\n' );
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+  double **matrix1, **matrix2, **matrix3, *work;
+  int size, numthreads, crossover, task_depth;
+  struct timeval tstart, tend;
+  double exectime;
+
+  crossover = ( argc == 4 )? atoi( argv[3] ) : STRASSEN_CROSSOVER;
+  if ((argc != 3 && argc != 4) || crossover <= 0) {
+    fprintf( stderr, "%s <matrix size> <number of thread> [crossover > 0]\n", argv[0] );
+    return -1;
+  }
+
+  size = atoi( argv[1] );
+  numthreads = atoi( argv[2] );
+
+  omp_set_dynamic( 0 ); // disable dynamic adjustment
+  omp_set_num_threads( numthreads );
+  task_depth = strassen_task_depth( numthreads );
+
+  matrix1 = allocate_matrix( size );
+  matrix2 = allocate_matrix( size );
+  matrix3 = allocate_matrix( size );
+  
+  init_matrix( matrix1, size );
+  init_matrix( matrix2, size );
+
+  /* The whole workspace of the recursion is allocated up front. */
+  work = (double *) malloc( strassen_workspace( size, crossover, task_depth ) * sizeof(double) );
+
+  if ( size <= 10 ) {
+    printf( "Matrix 1:\n" );
+    print_matrix( matrix1, size );
+    printf( "Matrix 2:\n" );
+    print_matrix( matrix2, size );
+  }
+
+  gettimeofday( &tstart, NULL );
+  strassen( size, matrix1[0], size, matrix2[0], size, matrix3[0], size,
+	    crossover, task_depth, work );
+  gettimeofday( &tend, NULL );
+  
+  if ( size <= 10 ) {
+    printf( "Matrix 3:\n" );
+    print_matrix( matrix3, size );
+  }
+
+  exectime = (tend.tv_sec - tstart.tv_sec) * 1000.0; // sec to ms
+  exectime += (tend.tv_usec - tstart.tv_usec) / 1000.0; // us to ms   
+
+  printf( "Number of MPI ranks: 0\tNumber of threads: %d\tExecution time:%.3lf sec\n",
+          numthreads, exectime/1000.0);
+
+  return 0;
+}
@@ -0,0 +1,273 @@
+/**
+ * Matrix (N*N) multiplication with SUMMA on a 2-D grid of MPI ranks.
+ *
+ * The ranks form a pr x pc Cartesian grid and every matrix is cut into
+ * the same pr x pc blocks, so each rank only stores its own block of
+ * 'matrix1', 'matrix2' and 'matrix3' (O(N*N/P) memory per rank instead
+ * of the whole 'matrix2').
+ *
+ * The k dimension is walked in panels of at most 'panel' columns. For
+ * each panel the ranks in the owning grid column broadcast their
+ * columns of 'matrix1' along their grid row, the ranks in the owning
+ * grid row broadcast their rows of 'matrix2' along their grid column,
+ * and every rank adds the product of the two panels to its block of
+ * 'matrix3'. The broadcasts are nonblocking and double buffered: the
+ * panels for step s+1 are in flight while step s is being multiplied.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpi.h"
+#include "matrix-type.h"
+
+#define TAG 10
+#define PANEL 256 // default panel width
+#define ROWS_PER_TEST 128 // rows multiplied between two MPI_Testall
+
+int size, panel;
+int dims[2] = { 0, 0 }, coords[2]; // shape of the process grid and my place in it
+int row_start, col_start, myrows, mycols; // my block of every matrix
+elem_t *matrix1, *matrix2; // my blocks
+result_t *matrix3;
+elem_t *panel1[2], *panel2[2]; // double buffered panels
+MPI_Comm grid_comm, row_comm, col_comm;
+
+/*
+ * First index of block 'b' when 'size' indices are split into 'nblocks'
+ * nearly equal blocks. Block b covers [block_start(b), block_start(b+1)).
+ */
+int block_start( int size, int nblocks, int b )
+{
+  return (int) ((long) size * b / nblocks);
+}
+
+/*
+ * Index of the block that holds index 'k'.
+ */
+int block_owner( int size, int nblocks, int k )
+{
+  int b = (int) (((long) k * nblocks) / size);
+  while (block_start( size, nblocks, b+1 ) <= k) ++b;
+  while (block_start( size, nblocks, b ) > k) --b;
+  return b;
+}
+
+int min3( int a, int b, int c )
+{
+  int m = ( a < b )? a : b;
+  return ( m < c )? m : c;
+}
+
+/*
+ * Width of the panel starting at 'k0'. A panel never crosses a block
+ * boundary, so its columns of 'matrix1' live in a single grid column
+ * and its rows of 'matrix2' in a single grid row.
+ */
+int panel_width( int k0 )
+{
+  return min3( panel,
+	       block_start( size, dims[1], block_owner( size, dims[1], k0 )+1 ) - k0,
+	       block_start( size, dims[0], block_owner( size, dims[0], k0 )+1 ) - k0 );
+}
+
+/*
+ * Start the broadcasts of the panels [k0, k0+width) into buffer 'buf':
+ * columns of 'matrix1' along my grid row and rows of 'matrix2' along
+ * my grid column.
+ */
+void post_panels( int k0, int width, int buf, MPI_Request reqs[2] )
+{
+  int owner_col = block_owner( size, dims[1], k0 );
+  int owner_row = block_owner( size, dims[0], k0 );
+  int i;
+
+  if (coords[1] == owner_col) { // copy my columns of 'matrix1' into the panel
+    for (i = 0; i < myrows; ++i) {
+      memcpy( &panel1[buf][ i * width ], &matrix1[ i * mycols + (k0 - col_start) ],
+	      width * sizeof(elem_t) );
+    }
+  }
+  MPI_Ibcast( panel1[buf], myrows * width, MPI_ELEM, owner_col, row_comm, &reqs[0] );
+
+  if (coords[0] == owner_row) { // my rows of 'matrix2' are already contiguous
+    memcpy( panel2[buf], &matrix2[ (k0 - row_start) * mycols ],
+	    width * mycols * sizeof(elem_t) );
+  }
+  MPI_Ibcast( panel2[buf], width * mycols, MPI_ELEM, owner_row, col_comm, &reqs[1] );
+}
+
+void print_matrix( double *matrix, int size )
+{
+  int i, j;
+
+  for (i = 0; i < size; ++i) {
+    for (j = 0; j < size-1; ++j) {
+      printf( "%lf, ", matrix[ i * size + j ] );
+    }
+    printf( "%lf", matrix[ i * size + j ] );
+    putchar( '\n' );
+  }
+}
+
+/*
+ * Collect the distributed blocks of a matrix of MPI type 'type'
+ * (MPI_ELEM or MPI_RESULT) on rank 0 of 'grid_comm' and print it there
+ * (only used for small matrices).
+ */
+void print_distributed( void *block, MPI_Datatype type, const char *title )
+{
+  int myrank, numtasks, rank, i, j, rc[2], r0, c0, rows, cols, elem_size;
+  double *full;
+  char *buf;
+
+  MPI_Comm_rank( grid_comm, &myrank );
+  MPI_Comm_size( grid_comm, &numtasks );
+
+  if (myrank != 0) {
+    MPI_Send( block, myrows * mycols, type, 0, TAG, grid_comm );
+    return;
+  }
+
+  MPI_Type_size( type, &elem_size );
+  full = (double *) malloc( size * size * sizeof(double) );
+  buf = (char *) malloc( size * size * elem_size );
+  for (rank = 0; rank < numtasks; ++rank) {
+    MPI_Cart_coords( grid_comm, rank, 2, rc );
+    r0 = block_start( size, dims[0], rc[0] );
+    c0 = block_start( size, dims[1], rc[1] );
+    rows = block_start( size, dims[0], rc[0]+1 ) - r0;
+    cols = block_start( size, dims[1], rc[1]+1 ) - c0;
+    if (rank == 0)
+      memcpy( buf, block, rows * cols * elem_size );
+    else
+      MPI_Recv( buf, rows * cols, type, rank, TAG, grid_comm, MPI_STATUS_IGNORE );
+    for (i = 0; i < rows; ++i) {
+      for (j = 0; j < cols; ++j) {
+	full[ (r0+i) * size + c0 + j ] = ( elem_size == sizeof(float) )?
+	  ((float *) buf)[ i * cols + j ] : ((double *) buf)[ i * cols + j ];
+      }
+    }
+  }
+
+  printf( "%s:\n", title );
+  print_matrix( full, size );
+  free( full );
+  free( buf );
+}
+
+/**
+ * Calculate:
+ * matrix3 <- matrix1 * matrix2
+ */
+int main( int argc, char *argv[] )
+{
+  int i, myrank, numtasks, step, cur, rows_done;
+  int periods[2] = { 0, 0 }, keep[2];
+  int k0, width, next_k0, next_width = 0;
+  double start_time = 0.0, end_time = 0.0;
+  MPI_Request reqs[2];
+
+  if (argc != 2 && argc != 3) {
+    fprintf( stderr, "%s <matrix size> [panel width]\n", argv[0] );
+    return -1;
+  }
+
+  size = atoi( argv[1] );
+  panel = ( argc == 3 )? atoi( argv[2] ) : PANEL;
+
+  MPI_Init( &argc, &argv );
+  MPI_Comm_size( MPI_COMM_WORLD, &numtasks );
+
+  /* Build the pr x pc process grid and one communicator per grid row
+     and per grid column. */
+  MPI_Dims_create( numtasks, 2, dims );
+  MPI_Cart_create( MPI_COMM_WORLD, 2, dims, periods, 1, &grid_comm );
+  MPI_Comm_rank( grid_comm, &myrank );
+  MPI_Cart_coords( grid_comm, myrank, 2, coords );
+  keep[0] = 0; keep[1] = 1;
+  MPI_Cart_sub( grid_comm, keep, &row_comm ); // rank in row_comm == coords[1]
+  keep[0] = 1; keep[1] = 0;
+  MPI_Cart_sub( grid_comm, keep, &col_comm ); // rank in col_comm == coords[0]
+
+  if ( myrank == 0 && (size < dims[0] || size < dims[1] || panel <= 0) ) {
+    fprintf( stderr, "size %d is too small for a %dx%d process grid\n", size, dims[0], dims[1] );
+    MPI_Abort( MPI_COMM_WORLD, -1 );
+  }
+
+  /* My block of every matrix. */
+  row_start = block_start( size, dims[0], coords[0] );
+  col_start = block_start( size, dims[1], coords[1] );
+  myrows = block_start( size, dims[0], coords[0]+1 ) - row_start;
+  mycols = block_start( size, dims[1], coords[1]+1 ) - col_start;
+
+  matrix1 = (elem_t *) malloc( myrows * mycols * sizeof(elem_t) );
+  matrix2 = (elem_t *) malloc( myrows * mycols * sizeof(elem_t) );
+  matrix3 = (result_t *) malloc( myrows * mycols * sizeof(result_t) );
+  for (i = 0; i < myrows * mycols; ++i) { // every rank initializes its own blocks
+    matrix1[ i ] = 1.0;
+    matrix2[ i ] = 1.0;
+  }
+
+  /* Panels: 'myrows' x width of 'matrix1' and width x 'mycols' of 'matrix2'. */
+  for (i = 0; i < 2; ++i) {
+    panel1[ i ] = (elem_t *) malloc( myrows * panel * sizeof(elem_t) );
+    panel2[ i ] = (elem_t *) malloc( panel * mycols * sizeof(elem_t) );
+  }
+
+  if ( size <= 10 ) {
+    print_distributed( matrix1, MPI_ELEM, "Matrix 1" );
+    print_distributed( matrix2, MPI_ELEM, "Matrix 2" );
+  }
+
+  MPI_Barrier( grid_comm );
+  if (myrank == 0) {
+    start_time = MPI_Wtime();
+  }
+
+  k0 = 0;
+  width = panel_width( k0 );
+  post_panels( k0, width, 0, reqs );
+
+  for (step = 0; k0 < size; ++step) {
+    cur = step % 2;
+    MPI_Waitall( 2, reqs, MPI_STATUSES_IGNORE );
+
+    /* Start broadcasting the next panels before multiplying these. */
+    next_k0 = k0 + width;
+    if (next_k0 < size) {
+      next_width = panel_width( next_k0 );
+      post_panels( next_k0, next_width, 1 - cur, reqs );
+    }
+
+    /* matrix3 += panel1 * panel2, a few rows at a time so that MPI gets
+       a chance to progress the broadcasts in flight. */
+    for (rows_done = 0; rows_done < myrows; rows_done += ROWS_PER_TEST) {
+      int rows = ( myrows - rows_done < ROWS_PER_TEST )? myrows - rows_done : ROWS_PER_TEST;
+      int flag;
+      matrix_gemm( rows, mycols, width, &panel1[cur][ rows_done * width ], width,
+		   panel2[cur], mycols, ( step == 0 )? 0.0 : 1.0,
+		   &matrix3[ rows_done * mycols ], mycols );
+      if (next_k0 < size)
+	MPI_Testall( 2, reqs, &flag, MPI_STATUSES_IGNORE );
+    }
+
+    k0 = next_k0;
+    width = next_width;
+  }
+
+  if (myrank == 0) {
+    end_time = MPI_Wtime();
+  }
+
+  if ( size <= 10 ) {
+    print_distributed( matrix3, MPI_RESULT, "Matrix 3" );
+  }
+
+  if ( myrank == 0 ) {
+    printf( "Number of MPI ranks: %d\tNumber of threads: 0\tExecution time: %lf sec\tProcess grid: %dx%d\n",
+	    numtasks, end_time-start_time, dims[0], dims[1] );
+  }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * Thread pinning and page interleaving (see matrix-place.h).
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#ifdef USE_LIBNUMA
+#include <numa.h>
+#endif
+#include "matrix-place.h"
+
+static int *cpus = NULL; // CPUs to pin to, in order
+static int num_cpus = 0;
+
+int place_cpus( const char *list )
+{
+  const char *p = list;
+  char *end;
+  long first, last, c;
+
+  num_cpus = 0;
+  for (;;) {
+    first = strtol( p, &end, 10 );
+    if (end == p || first < 0)
+      return -1;
+    last = first;
+    if (*end == '-') {
+      p = end + 1;
+      last = strtol( p, &end, 10 );
+      if (end == p || last < first)
+	return -1;
+    }
+    cpus = (int *) realloc( cpus, (num_cpus + last - first + 1) * sizeof(int) );
+    for (c = first; c <= last; ++c) {
+      cpus[ num_cpus++ ] = (int) c;
+    }
+    if (*end == '\0')
+      return num_cpus;
+    if (*end != ',')
+      return -1;
+    p = end + 1;
+  }
+}
+
+int place_pin( int k )
+{
+  cpu_set_t set;
+  int err;
+
+  if (num_cpus == 0)
+    return 0;
+
+  CPU_ZERO( &set );
+  CPU_SET( cpus[ k % num_cpus ], &set );
+  err = pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+  if (err != 0)
+    fprintf( stderr, "cannot pin thread %d to CPU %d\n", k, cpus[ k % num_cpus ] );
+  return err;
+}
+
+int place_interleave( void *p, size_t len )
+{
+#ifdef USE_LIBNUMA
+  uintptr_t page = (uintptr_t) sysconf( _SC_PAGESIZE );
+  uintptr_t start = (uintptr_t) p & ~(page - 1); // mbind() wants whole pages
+
+  if (numa_available() == -1)
+    return -1;
+  numa_interleave_memory( (void *) start, (uintptr_t) p + len - start, numa_all_nodes_ptr );
+  return 0;
+#else
+  (void) p;
+  (void) len;
+  return -1;
+#endif
+}
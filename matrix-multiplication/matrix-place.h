@@ -0,0 +1,43 @@
+/**
+ * Placement of threads and memory on NUMA machines.
+ *
+ * Linux puts a page on the NUMA node of the thread that first writes
+ * it, so a matrix that one thread initializes ends up on one node and the
+ * threads on the other nodes work on remote memory. The drivers
+ * therefore let every thread initialize the rows it computes, and these
+ * helpers add the two other pieces:
+ *
+ * - place_cpus()/place_pin(): pin thread k to the k-th CPU of a list
+ *   given on the command line, so that a thread stays next to its rows
+ *   (the OpenMP drivers do this inside their first parallel region, as
+ *   libgomp reads OMP_PLACES/OMP_PROC_BIND before main() runs).
+ * - place_interleave(): spread the pages of a buffer round-robin over
+ *   all nodes instead, for data every thread reads. It needs libnuma
+ *   (make NUMA=1).
+ */
+#ifndef MATRIX_PLACE_H
+#define MATRIX_PLACE_H
+
+#include <stddef.h>
+
+/**
+ * Set the CPUs to pin to from a list like "0-3,8,10-11". Returns the
+ * number of CPUs, or -1 if the list is malformed.
+ */
+int place_cpus( const char *list );
+
+/**
+ * Pin the calling thread to CPU number 'k' (modulo the length) of the
+ * list given to place_cpus(); does nothing without a list. Returns 0,
+ * or the error of pthread_setaffinity_np().
+ */
+int place_pin( int k );
+
+/**
+ * Interleave the pages of 'len' bytes at 'p', which must not be touched
+ * yet, over all NUMA nodes. Returns 0, or -1 without libnuma or NUMA
+ * support.
+ */
+int place_interleave( void *p, size_t len );
+
+#endif
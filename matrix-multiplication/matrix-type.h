@@ -0,0 +1,44 @@
+/**
+ * Element types of the matrix-mul-* drivers, chosen at compile time:
+ *   (default)      double matrices,
+ *   -DMATRIX_FLOAT float matrices,
+ *   -DMATRIX_MIXED float 'matrix1' and 'matrix2', double 'matrix3'
+ *                  (the products are accumulated in double).
+ * 'elem_t' is the type of the two operands, 'result_t' the type of the
+ * product and matrix_gemm() the gemm variant that multiplies them.
+ * When mpi.h is included first, MPI_ELEM and MPI_RESULT are the
+ * matching MPI datatypes.
+ */
+#ifndef MATRIX_TYPE_H
+#define MATRIX_TYPE_H
+
+#include "gemm.h"
+
+#if defined(MATRIX_FLOAT)
+typedef float elem_t;
+typedef float result_t;
+#define matrix_gemm gemm_s
+#elif defined(MATRIX_MIXED)
+typedef float elem_t;
+typedef double result_t;
+#define matrix_gemm gemm_sd
+#else
+typedef double elem_t;
+typedef double result_t;
+#define matrix_gemm gemm
+#endif
+
+#ifdef MPI_VERSION
+#if defined(MATRIX_FLOAT)
+#define MPI_ELEM MPI_FLOAT
+#define MPI_RESULT MPI_FLOAT
+#elif defined(MATRIX_MIXED)
+#define MPI_ELEM MPI_FLOAT
+#define MPI_RESULT MPI_DOUBLE
+#else
+#define MPI_ELEM MPI_DOUBLE
+#define MPI_RESULT MPI_DOUBLE
+#endif
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Thread scaling of the hybrid (MPI + OpenMP) matrix multiplication:
+# for each number of ranks, run 1, 2, 4 and 8 threads per rank and
+# report the speedup over 1 thread per rank. Ranks are not bound to a
+# core, otherwise all threads of a rank would share a single core.
+
+# compile the code
+make hybrid-mm
+
+# file for outputs
+output="output_hybrid.txt"
+rm -f $output
+
+size=2400
+END=3
+
+echo "matrix size: $size" >> $output
+for ranks in 1 2 4 8
+do
+    base=""
+    for threads in 1 2 4 8
+    do
+	echo "hybrid-mm $ranks ranks $threads threads" >> $output
+	best=""
+	for i in $(seq 1 $END)
+	do
+	    line=$(mpirun -np $ranks --hostfile hostfile --bind-to none ./hybrid-mm $size $threads | grep "Execution time")
+	    echo "$line" >> $output
+	    t=$(echo "$line" | sed 's/.*Execution time: \([0-9.]*\).*/\1/')
+	    if [ -z "$best" ] || [ $(echo "$t < $best" | bc) -eq 1 ]; then
+		best=$t
+	    fi
+	done
+	if [ -z "$base" ]; then
+	    base=$best
+	fi
+	echo "best: $best sec, speedup over 1 thread/rank: $(echo "scale=2; $base / $best" | bc)" >> $output
+    done
+done
@@ -0,0 +1,102 @@
+/**
+ * Find the Strassen-Winograd crossover on this machine.
+ *
+ * For one matrix size it times a single gemm() call on the whole
+ * matrices and strassen() with crossovers 64, 128, ... up to the matrix
+ * size, and reports the fastest crossover together with the largest
+ * difference to the gemm() result. A crossover of at least the matrix
+ * size is that same gemm() call, so its speedup is about 1.
+ *
+ * Every candidate runs ROUNDS times and the best time counts; the first
+ * round is a warm-up. All crossovers share one workspace, the largest
+ * any of them needs, which is touched before the first timing so that
+ * no page fault of the arena lands in a timed run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "omp.h"
+#include "gemm.h"
+#include "strassen.h"
+
+#define ROUNDS 3 // runs of every candidate, the first only warms up
+
+int main( int argc, char *argv[] )
+{
+  int size, numthreads, crossover, task_depth, best_crossover = 0, i, round;
+  double *A, *B, *C, *R, *work;
+  double start, t, t_gemm = 0.0, t_strassen = 0.0, best_time = 0.0, diff;
+  size_t len, max_len = 0;
+
+  if (argc != 3) {
+    fprintf( stderr, "%s <matrix size> <number of threads>\n", argv[0] );
+    return -1;
+  }
+
+  size = atoi( argv[1] );
+  numthreads = atoi( argv[2] );
+  omp_set_dynamic( 0 );
+  omp_set_num_threads( numthreads );
+  task_depth = strassen_task_depth( numthreads );
+
+  A = (double *) malloc( (size_t) size * size * sizeof(double) );
+  B = (double *) malloc( (size_t) size * size * sizeof(double) );
+  C = (double *) malloc( (size_t) size * size * sizeof(double) );
+  R = (double *) malloc( (size_t) size * size * sizeof(double) );
+  for (i = 0; i < size * size; ++i) {
+    A[ i ] = (i % 13) * 0.1 - 0.6;
+    B[ i ] = (i % 7) * 0.3 - 0.9;
+  }
+  memset( C, 0, (size_t) size * size * sizeof(double) );
+  memset( R, 0, (size_t) size * size * sizeof(double) );
+
+  for (crossover = 64; crossover < 2 * size; crossover *= 2) {
+    len = strassen_workspace( size, crossover, task_depth );
+    if (len > max_len)
+      max_len = len;
+  }
+  work = (double *) malloc( max_len * sizeof(double) );
+  memset( work, 0, max_len * sizeof(double) );
+
+  for (round = 0; round < ROUNDS; ++round) {
+    start = omp_get_wtime();
+    gemm( size, size, size, A, size, B, size, 0.0, R, size );
+    t = omp_get_wtime() - start;
+    if (round == 1 || (round > 1 && t < t_gemm))
+      t_gemm = t;
+  }
+
+  printf( "matrix size: %d\tthreads: %d\tmicro-kernel: %s\n", size, numthreads, gemm_kernel_name() );
+  printf( "gemm\t\t%.3lf sec\n", t_gemm );
+  printf( "crossover\ttime(s)\tspeedup\tworkspace(MB)\tmax diff\n" );
+
+  for (crossover = 64; crossover < 2 * size; crossover *= 2) {
+    len = strassen_workspace( size, crossover, task_depth );
+
+    for (round = 0; round < ROUNDS; ++round) {
+      start = omp_get_wtime();
+      strassen( size, A, size, B, size, C, size, crossover, task_depth, work );
+      t = omp_get_wtime() - start;
+      if (round == 1 || (round > 1 && t < t_strassen))
+	t_strassen = t;
+    }
+
+    diff = 0.0;
+    for (i = 0; i < size * size; ++i) {
+      diff = fmax( diff, fabs( C[ i ] - R[ i ] ) );
+    }
+
+    printf( "%d\t\t%.3lf\t%.2lf\t%.1lf\t\t%g\n", crossover, t_strassen, t_gemm / t_strassen,
+	    len * sizeof(double) / 1048576.0, diff );
+    if (best_crossover == 0 || t_strassen < best_time) {
+      best_crossover = crossover;
+      best_time = t_strassen;
+    }
+  }
+
+  printf( "best crossover: %d (%.3lf sec, %s than gemm)\n", best_crossover, best_time,
+	  ( best_time < t_gemm )? "faster" : "slower" );
+
+  return 0;
+}
@@ -0,0 +1,255 @@
+/**
+ * Strassen-Winograd recursive multiplication.
+ *
+ * With the quadrants A11..A22, B11..B22 of A and B, Winograd's variant
+ * needs 7 products and 15 additions:
+ *   S1 = A21 + A22   T1 = B12 - B11   P1 = A11 * B11   P5 = S1 * T1
+ *   S2 = S1 - A11    T2 = B22 - T1    P2 = A12 * B21   P6 = S2 * T2
+ *   S3 = A11 - A21   T3 = B22 - B12   P3 = S4 * B22    P7 = S3 * T3
+ *   S4 = A12 - S2    T4 = T2 - B21    P4 = A22 * T4
+ *   U2 = P1 + P6   U3 = U2 + P7   U4 = U2 + P5
+ *   C11 = P1 + P2   C12 = U4 + P3   C21 = U3 - P4   C22 = U3 + P5
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "gemm.h"
+#include "strassen.h"
+#include "omp.h"
+
+/* Z <- X + Y and Z <- X - Y on h*h blocks. */
+static void add( int h, const double *X, int ldx, const double *Y, int ldy,
+		 double *Z, int ldz )
+{
+  int i, j;
+
+  for (i = 0; i < h; ++i) {
+    for (j = 0; j < h; ++j) {
+      Z[ i * ldz + j ] = X[ i * ldx + j ] + Y[ i * ldy + j ];
+    }
+  }
+}
+
+static void sub( int h, const double *X, int ldx, const double *Y, int ldy,
+		 double *Z, int ldz )
+{
+  int i, j;
+
+  for (i = 0; i < h; ++i) {
+    for (j = 0; j < h; ++j) {
+      Z[ i * ldz + j ] = X[ i * ldx + j ] - Y[ i * ldy + j ];
+    }
+  }
+}
+
+static int is_leaf( int n, int crossover )
+{
+  return n <= crossover || n % 2 != 0;
+}
+
+static size_t serial_workspace( int n, int crossover )
+{
+  size_t h = n / 2;
+
+  if (is_leaf( n, crossover ))
+    return 0;
+  return 2 * h * h + serial_workspace( n / 2, crossover );
+}
+
+static size_t parallel_workspace( int n, int crossover, int task_depth )
+{
+  size_t h = n / 2;
+
+  if (is_leaf( n, crossover ))
+    return 0;
+  if (task_depth == 0)
+    return serial_workspace( n, crossover );
+  return 11 * h * h + 7 * parallel_workspace( n / 2, crossover, task_depth-1 );
+}
+
+/*
+ * Size the matrices are padded to: the smallest multiple of 2^levels
+ * that is >= n, where levels is the recursion depth needed to get
+ * below the crossover.
+ */
+static int padded_size( int n, int crossover )
+{
+  int levels = 0, leaf = n;
+
+  if (crossover < 1)
+    crossover = 1;
+  while (leaf > crossover) {
+    leaf = (leaf + 1) / 2;
+    ++levels;
+  }
+  return leaf << levels;
+}
+
+/**
+ * Sequential recursion with the two-temporary schedule: X holds the
+ * sums of A blocks, Y the sums of B blocks, and the quadrants of C
+ * hold the products until they are combined.
+ */
+static void winograd_serial( int n, const double *A, int lda,
+			     const double *B, int ldb,
+			     double *C, int ldc,
+			     int crossover, double *work )
+{
+  int h = n / 2;
+  const double *A11, *A12, *A21, *A22, *B11, *B12, *B21, *B22;
+  double *C11, *C12, *C21, *C22, *X, *Y, *rest;
+
+  if (is_leaf( n, crossover )) {
+    gemm( n, n, n, A, lda, B, ldb, 0.0, C, ldc );
+    return;
+  }
+
+  A11 = A; A12 = A + h; A21 = A + h * lda; A22 = A21 + h;
+  B11 = B; B12 = B + h; B21 = B + h * ldb; B22 = B21 + h;
+  C11 = C; C12 = C + h; C21 = C + h * ldc; C22 = C21 + h;
+  X = work;
+  Y = work + (size_t) h * h;
+  rest = Y + (size_t) h * h;
+
+  sub( h, A11, lda, A21, lda, X, h );                    // S3
+  sub( h, B22, ldb, B12, ldb, Y, h );                    // T3
+  winograd_serial( h, X, h, Y, h, C21, ldc, crossover, rest ); // P7
+  add( h, A21, lda, A22, lda, X, h );                    // S1
+  sub( h, B12, ldb, B11, ldb, Y, h );                    // T1
+  winograd_serial( h, X, h, Y, h, C22, ldc, crossover, rest ); // P5
+  sub( h, X, h, A11, lda, X, h );                        // S2
+  sub( h, B22, ldb, Y, h, Y, h );                        // T2
+  winograd_serial( h, X, h, Y, h, C12, ldc, crossover, rest ); // P6
+  sub( h, A12, lda, X, h, X, h );                        // S4
+  winograd_serial( h, X, h, B22, ldb, C11, ldc, crossover, rest ); // P3
+  winograd_serial( h, A11, lda, B11, ldb, X, h, crossover, rest ); // P1
+  add( h, X, h, C12, ldc, C12, ldc );                    // U2 = P1 + P6
+  add( h, C12, ldc, C21, ldc, C21, ldc );                // U3 = U2 + P7
+  add( h, C12, ldc, C22, ldc, C12, ldc );                // U4 = U2 + P5
+  add( h, C21, ldc, C22, ldc, C22, ldc );                // C22 = U3 + P5
+  add( h, C12, ldc, C11, ldc, C12, ldc );                // C12 = U4 + P3
+  sub( h, Y, h, B21, ldb, Y, h );                        // T4
+  winograd_serial( h, A22, lda, Y, h, C11, ldc, crossover, rest ); // P4
+  sub( h, C21, ldc, C11, ldc, C21, ldc );                // C21 = U3 - P4
+  winograd_serial( h, A12, lda, B21, ldb, C11, ldc, crossover, rest ); // P2
+  add( h, X, h, C11, ldc, C11, ldc );                    // C11 = P1 + P2
+}
+
+/**
+ * Task-parallel recursion: all S and T blocks are formed first, then
+ * the seven products run as independent tasks. P2..P5 are written
+ * straight into the quadrants of C, P1, P6 and P7 into temporaries.
+ * Each task gets its own slice of the arena.
+ */
+static void winograd_parallel( int n, const double *A, int lda,
+			       const double *B, int ldb,
+			       double *C, int ldc,
+			       int crossover, int task_depth, double *work )
+{
+  int h = n / 2, i, j;
+  size_t hh = (size_t) h * h, child;
+  const double *A11, *A12, *A21, *A22, *B11, *B12, *B21, *B22;
+  double *C11, *C12, *C21, *C22;
+  double *S1, *S2, *S3, *S4, *T1, *T2, *T3, *T4, *P1, *P6, *P7, *rest;
+
+  if (task_depth == 0 || is_leaf( n, crossover )) {
+    winograd_serial( n, A, lda, B, ldb, C, ldc, crossover, work );
+    return;
+  }
+
+  A11 = A; A12 = A + h; A21 = A + h * lda; A22 = A21 + h;
+  B11 = B; B12 = B + h; B21 = B + h * ldb; B22 = B21 + h;
+  C11 = C; C12 = C + h; C21 = C + h * ldc; C22 = C21 + h;
+  S1 = work;       S2 = S1 + hh; S3 = S2 + hh; S4 = S3 + hh;
+  T1 = S4 + hh;    T2 = T1 + hh; T3 = T2 + hh; T4 = T3 + hh;
+  P1 = T4 + hh;    P6 = P1 + hh; P7 = P6 + hh;
+  rest = P7 + hh;
+  child = parallel_workspace( h, crossover, task_depth-1 );
+
+  add( h, A21, lda, A22, lda, S1, h );
+  sub( h, S1, h, A11, lda, S2, h );
+  sub( h, A11, lda, A21, lda, S3, h );
+  sub( h, A12, lda, S2, h, S4, h );
+  sub( h, B12, ldb, B11, ldb, T1, h );
+  sub( h, B22, ldb, T1, h, T2, h );
+  sub( h, B22, ldb, B12, ldb, T3, h );
+  sub( h, T2, h, B21, ldb, T4, h );
+
+#pragma omp task
+  winograd_parallel( h, A11, lda, B11, ldb, P1, h, crossover, task_depth-1, rest );
+#pragma omp task
+  winograd_parallel( h, A12, lda, B21, ldb, C11, ldc, crossover, task_depth-1, rest + child );
+#pragma omp task
+  winograd_parallel( h, S4, h, B22, ldb, C12, ldc, crossover, task_depth-1, rest + 2 * child );
+#pragma omp task
+  winograd_parallel( h, A22, lda, T4, h, C21, ldc, crossover, task_depth-1, rest + 3 * child );
+#pragma omp task
+  winograd_parallel( h, S1, h, T1, h, C22, ldc, crossover, task_depth-1, rest + 4 * child );
+#pragma omp task
+  winograd_parallel( h, S2, h, T2, h, P6, h, crossover, task_depth-1, rest + 5 * child );
+#pragma omp task
+  winograd_parallel( h, S3, h, T3, h, P7, h, crossover, task_depth-1, rest + 6 * child );
+#pragma omp taskwait
+
+  /* C11 holds P2, C12 P3, C21 P4 and C22 P5. */
+  for (i = 0; i < h; ++i) {
+    for (j = 0; j < h; ++j) {
+      double u2 = P1[ i * h + j ] + P6[ i * h + j ];
+      double u3 = u2 + P7[ i * h + j ];
+      double p5 = C22[ i * ldc + j ];
+      C11[ i * ldc + j ] = P1[ i * h + j ] + C11[ i * ldc + j ];
+      C12[ i * ldc + j ] = (u2 + p5) + C12[ i * ldc + j ];
+      C21[ i * ldc + j ] = u3 - C21[ i * ldc + j ];
+      C22[ i * ldc + j ] = u3 + p5;
+    }
+  }
+}
+
+int strassen_task_depth( int numthreads )
+{
+  if (numthreads <= 1) return 0;
+  if (numthreads <= 7) return 1;
+  return 2;
+}
+
+size_t strassen_workspace( int n, int crossover, int task_depth )
+{
+  int p = padded_size( n, crossover );
+  size_t pad = ( p != n )? 3 * (size_t) p * p : 0;
+
+  return pad + parallel_workspace( p, crossover, task_depth );
+}
+
+void strassen( int n, const double *A, int lda,
+	       const double *B, int ldb,
+	       double *C, int ldc,
+	       int crossover, int task_depth, double *work )
+{
+  int p = padded_size( n, crossover ), i;
+  double *Ap, *Bp, *Cp;
+
+  if (p == n) {
+#pragma omp parallel
+#pragma omp single
+    winograd_parallel( n, A, lda, B, ldb, C, ldc, crossover, task_depth, work );
+    return;
+  }
+
+  /* Embed A and B in zero padded p*p matrices so that every level of
+     the recursion splits evenly. */
+  Ap = work;
+  Bp = Ap + (size_t) p * p;
+  Cp = Bp + (size_t) p * p;
+  memset( Ap, 0, 2 * (size_t) p * p * sizeof(double) );
+  for (i = 0; i < n; ++i) {
+    memcpy( &Ap[ (size_t) i * p ], &A[ (size_t) i * lda ], n * sizeof(double) );
+    memcpy( &Bp[ (size_t) i * p ], &B[ (size_t) i * ldb ], n * sizeof(double) );
+  }
+
+#pragma omp parallel
+#pragma omp single
+  winograd_parallel( p, Ap, p, Bp, p, Cp, p, crossover, task_depth, Cp + (size_t) p * p );
+
+  for (i = 0; i < n; ++i) {
+    memcpy( &C[ (size_t) i * ldc ], &Cp[ (size_t) i * p ], n * sizeof(double) );
+  }
+}
@@ -0,0 +1,41 @@
+/**
+ * Strassen-Winograd matrix multiplication on top of the blocked gemm
+ * engine.
+ *
+ * The recursion halves the matrices until they are no larger than
+ * 'crossover' and multiplies those with gemm(). At the top 'task_depth'
+ * levels the seven sub-products run as OpenMP tasks; below that the
+ * memory-lean sequential schedule is used. All temporaries come from
+ * one arena of strassen_workspace() doubles allocated by the caller.
+ */
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+#include <stddef.h>
+
+#define STRASSEN_CROSSOVER 512 // default size below which gemm() takes over
+
+/**
+ * Levels of the recursion that run their seven products as tasks for
+ * 'numthreads' threads: one level feeds up to 7 threads, two levels up
+ * to 49.
+ */
+int strassen_task_depth( int numthreads );
+
+/**
+ * Number of doubles of workspace strassen() needs for an n*n multiply.
+ */
+size_t strassen_workspace( int n, int crossover, int task_depth );
+
+/**
+ * Calculate:
+ * C <- A * B
+ * for n*n matrices. Opens its own OpenMP parallel region, so it uses
+ * the number of threads set with omp_set_num_threads().
+ */
+void strassen( int n, const double *A, int lda,
+	       const double *B, int ldb,
+	       double *C, int ldc,
+	       int crossover, int task_depth, double *work );
+
+#endif
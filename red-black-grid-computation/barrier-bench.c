@@ -0,0 +1,136 @@
+/**
+ * Cost of a barrier against the number of threads.
+ *
+ * For 1, 2, 4, ... up to the given number of threads it runs a loop of
+ * back-to-back barriers with every barrier of rb-barrier.h and with
+ * pthread_barrier_wait() for reference, and prints the time per barrier
+ * in nanoseconds.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "rb-barrier.h"
+#include "rb-place.h"
+
+#define ROUNDS 100000 // default number of barriers per measurement
+
+int num_threads, rounds = ROUNDS;
+int kind; // kind of barrier, BARRIER_KINDS for pthread_barrier_t
+barrier_t *barrier;
+pthread_barrier_t pbarrier;
+double elapsed; // seconds for 'rounds' barriers, measured by thread 0
+
+double now( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void team_wait( int id )
+{
+  if (kind == BARRIER_KINDS)
+    pthread_barrier_wait( &pbarrier );
+  else
+    barrier_wait( barrier, id );
+}
+
+void * worker( void *arg )
+{
+  int id = *((int *) arg);
+  int i;
+  double start = 0.0;
+
+  place_pin( id );
+  team_wait( id ); // all threads are running
+  if (id == 0)
+    start = now();
+  for (i = 0; i < rounds; ++i) {
+    team_wait( id );
+  }
+  if (id == 0)
+    elapsed = now() - start;
+
+  return NULL;
+}
+
+/*
+ * Nanoseconds per barrier of 'kind' with 'n' threads.
+ */
+double measure( int n )
+{
+  pthread_t threads[ n ];
+  int ids[ n ];
+  int i;
+
+  num_threads = n;
+  if (kind == BARRIER_KINDS)
+    pthread_barrier_init( &pbarrier, NULL, n );
+  else
+    barrier = barrier_create( kind, n );
+
+  for (i = 0; i < n; ++i) {
+    ids[ i ] = i;
+    pthread_create( &threads[ i ], NULL, worker, &ids[ i ] );
+  }
+  for (i = 0; i < n; ++i) {
+    pthread_join( threads[ i ], NULL );
+  }
+
+  if (kind == BARRIER_KINDS)
+    pthread_barrier_destroy( &pbarrier );
+  else
+    barrier_destroy( barrier );
+
+  return elapsed / rounds * 1e9;
+}
+
+int main( int argc, char *argv[] )
+{
+  int opt, max_threads, n;
+
+  while ((opt = getopt( argc, argv, "r:p:" )) != -1) {
+    switch (opt) {
+    case 'r':
+      rounds = atoi( optarg );
+      break;
+    case 'p':
+      if (place_cpus( optarg ) < 0)
+	argc = 0;
+      break;
+    default:
+      argc = 0; // print the usage below
+    }
+  }
+
+  if (argc - optind != 1 || rounds < 1 || atoi( argv[optind] ) < 1) {
+    fprintf( stderr, "%s [-r rounds] [-p cpus] <max number of threads>\n", argv[0] );
+    fprintf( stderr, "  -r  barriers per measurement (default %d)\n", ROUNDS );
+    fprintf( stderr, "  -p  pin thread k to the k-th CPU of 'cpus', e.g. 0-7 or 0,2,4,6\n" );
+    return -1;
+  }
+  max_threads = atoi( argv[optind] );
+
+  printf( "ns per barrier, %d barriers\n", rounds );
+  printf( "threads" );
+  for (kind = 0; kind < BARRIER_KINDS; ++kind) {
+    printf( "\t%s", barrier_name( kind ) );
+  }
+  printf( "\tpthread\n" );
+
+  for (n = 1; ; n = ( 2*n < max_threads )? 2*n : max_threads) {
+    printf( "%d", n );
+    for (kind = 0; kind <= BARRIER_KINDS; ++kind) {
+      printf( "\t%.0lf", measure( n ) );
+      fflush( stdout );
+    }
+    putchar( '\n' );
+    if (n == max_threads)
+      break;
+  }
+
+  return 0;
+}
@@ -0,0 +1,302 @@
+/**
+ * Dissemination, tournament and combining tree barriers and standalone
+ * flags (see rb-barrier.h).
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "rb-barrier.h"
+
+#define CACHE_LINE 64
+
+/* A counter on a cache line of its own. 'sleeping' is set by a thread
+   before it sleeps on 'value'. */
+typedef struct {
+  _Alignas(CACHE_LINE) atomic_uint value;
+  atomic_int sleeping;
+} flag_t;
+
+/* A node of the combining tree. */
+typedef struct {
+  _Alignas(CACHE_LINE) atomic_uint count; // arrivals over all episodes
+  int fan_in;
+  int parent; // -1 for the root
+} node_t;
+
+/* What a thread keeps from one episode to the next. */
+typedef struct {
+  _Alignas(CACHE_LINE) unsigned episode;
+} thread_t;
+
+struct barrier {
+  int kind;
+  int n; // number of threads
+  int rounds; // ceil(log2 n)
+  int spins; // polls of a flag before sleeping on it
+  thread_t *threads;
+  flag_t *flags; // dissemination: rounds per thread; tournament: arrivals
+  flag_t *release; // tournament: one per thread; tree: one for all
+  int *partner; // dissemination and tournament: partner in every round
+  node_t *nodes; // combining tree, leaves first
+  int *leaf; // leaf of every thread
+};
+
+struct flags {
+  int spins;
+  flag_t *flag;
+};
+
+static const char *names[ BARRIER_KINDS ] = { "dissemination", "tournament", "tree" };
+
+static void *allocate( size_t count, size_t size )
+{
+  size_t len = (count * size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+  void *p = aligned_alloc( CACHE_LINE, len ? len : CACHE_LINE );
+
+  memset( p, 0, len );
+  return p;
+}
+
+static void cpu_relax( void )
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+/*
+ * Wait until 'f' has counted up to 'target'. The comparison is done on
+ * the difference, so the counters may wrap around.
+ */
+static void flag_wait( flag_t *f, unsigned target, int max_spins )
+{
+  unsigned v;
+  int spins = 0;
+
+  while ((int) ((v = atomic_load_explicit( &f->value, memory_order_acquire )) - target) < 0) {
+    if (spins++ < max_spins) {
+      cpu_relax();
+      continue;
+    }
+    /* Announce the sleep and look again (both sequentially consistent,
+       so flag_wake() sees the one or this load sees the new value). */
+    atomic_store( &f->sleeping, 1 );
+    v = atomic_load( &f->value );
+    if ((int) (v - target) < 0)
+      syscall( SYS_futex, &f->value, FUTEX_WAIT_PRIVATE, v, NULL, NULL, 0 );
+  }
+}
+
+/*
+ * Wake the threads sleeping on 'f' after its value has changed.
+ */
+static void flag_wake( flag_t *f )
+{
+  if (atomic_exchange( &f->sleeping, 0 ))
+    syscall( SYS_futex, &f->value, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0 );
+}
+
+static void flag_add( flag_t *f )
+{
+  atomic_fetch_add( &f->value, 1 );
+  flag_wake( f );
+}
+
+static void flag_set( flag_t *f, unsigned value )
+{
+  atomic_store( &f->value, value );
+  flag_wake( f );
+}
+
+/*
+ * Polls of a flag before sleeping on it for a team of 'num_threads':
+ * none with more threads than CPUs to run them.
+ */
+static int spins_for( int num_threads )
+{
+  cpu_set_t cpus;
+
+  if (sched_getaffinity( 0, sizeof(cpus), &cpus ) == 0 && num_threads > CPU_COUNT( &cpus ))
+    return 0;
+  return BARRIER_SPINS;
+}
+
+barrier_t *barrier_create( int kind, int num_threads )
+{
+  barrier_t *b;
+  int i, r, first, count, next;
+
+  if (kind < 0 || kind >= BARRIER_KINDS || num_threads < 1)
+    return NULL;
+
+  b = (barrier_t *) calloc( 1, sizeof(barrier_t) );
+  b->kind = kind;
+  b->n = num_threads;
+  for (b->rounds = 0; (1 << b->rounds) < num_threads; ++b->rounds) ;
+  b->spins = spins_for( num_threads );
+  b->threads = (thread_t *) allocate( num_threads, sizeof(thread_t) );
+
+  switch (kind) {
+  case BARRIER_DISSEMINATION:
+    /* partner[ i*rounds + r ]: the thread that i signals in round r. */
+    b->flags = (flag_t *) allocate( (size_t) num_threads * b->rounds, sizeof(flag_t) );
+    b->partner = (int *) malloc( ((size_t) num_threads * b->rounds + 1) * sizeof(int) );
+    for (i = 0; i < num_threads; ++i) {
+      for (r = 0; r < b->rounds; ++r) {
+	b->partner[ i * b->rounds + r ] = (i + (1 << r)) % num_threads;
+      }
+    }
+    break;
+
+  case BARRIER_TOURNAMENT:
+    /* partner[ i*rounds + r ]: the loser i waits for in round r (-1 for
+       a bye), or -2 - the winner i loses to. */
+    b->flags = (flag_t *) allocate( (size_t) num_threads * b->rounds, sizeof(flag_t) );
+    b->release = (flag_t *) allocate( num_threads, sizeof(flag_t) );
+    b->partner = (int *) malloc( ((size_t) num_threads * b->rounds + 1) * sizeof(int) );
+    for (i = 0; i < num_threads; ++i) {
+      for (r = 0; r < b->rounds; ++r) {
+	if (i % (2 << r) == 0)
+	  b->partner[ i * b->rounds + r ] = ( i + (1 << r) < num_threads )? i + (1 << r) : -1;
+	else if (i % (2 << r) == (1 << r))
+	  b->partner[ i * b->rounds + r ] = -2 - (i - (1 << r));
+	else
+	  b->partner[ i * b->rounds + r ] = -1; // out of the tournament already
+      }
+    }
+    break;
+
+  case BARRIER_TREE:
+    /* Level 0 has one node per BARRIER_FAN_IN threads, every further
+       level one node per BARRIER_FAN_IN nodes below, up to the root. */
+    b->nodes = (node_t *) allocate( 2 * num_threads, sizeof(node_t) );
+    b->leaf = (int *) malloc( num_threads * sizeof(int) );
+    b->release = (flag_t *) allocate( 1, sizeof(flag_t) );
+    for (i = 0; i < num_threads; ++i) {
+      b->leaf[ i ] = i / BARRIER_FAN_IN;
+    }
+    first = 0;
+    count = (num_threads + BARRIER_FAN_IN - 1) / BARRIER_FAN_IN;
+    for (i = 0; i < count; ++i) {
+      b->nodes[ i ].fan_in = ( num_threads - i * BARRIER_FAN_IN < BARRIER_FAN_IN )?
+	num_threads - i * BARRIER_FAN_IN : BARRIER_FAN_IN;
+    }
+    while (count > 1) {
+      next = first + count;
+      for (i = 0; i < count; ++i) {
+	b->nodes[ first + i ].parent = next + i / BARRIER_FAN_IN;
+	b->nodes[ next + i / BARRIER_FAN_IN ].fan_in++;
+      }
+      first = next;
+      count = (count + BARRIER_FAN_IN - 1) / BARRIER_FAN_IN;
+    }
+    b->nodes[ first ].parent = -1;
+    break;
+  }
+
+  return b;
+}
+
+void barrier_wait( barrier_t *b, int id )
+{
+  unsigned e = ++b->threads[ id ].episode;
+  int r, p, node;
+
+  switch (b->kind) {
+  case BARRIER_DISSEMINATION:
+    for (r = 0; r < b->rounds; ++r) {
+      flag_add( &b->flags[ b->partner[ id * b->rounds + r ] * b->rounds + r ] );
+      flag_wait( &b->flags[ id * b->rounds + r ], e, b->spins );
+    }
+    break;
+
+  case BARRIER_TOURNAMENT:
+    /* Win rounds until losing one (thread 0 never does), then wake the
+       losers of the rounds won, last round first. */
+    for (r = 0; r < b->rounds; ++r) {
+      p = b->partner[ id * b->rounds + r ];
+      if (p >= 0) {
+	flag_wait( &b->flags[ id * b->rounds + r ], e, b->spins );
+      } else if (p <= -2) {
+	flag_add( &b->flags[ (-2 - p) * b->rounds + r ] );
+	flag_wait( &b->release[ id ], e, b->spins );
+	break;
+      }
+    }
+    while (--r >= 0) {
+      p = b->partner[ id * b->rounds + r ];
+      if (p >= 0)
+	flag_set( &b->release[ p ], e );
+    }
+    break;
+
+  case BARRIER_TREE:
+    /* Climb while being the last to arrive at a node. */
+    for (node = b->leaf[ id ]; node >= 0; node = b->nodes[ node ].parent) {
+      if (atomic_fetch_add( &b->nodes[ node ].count, 1 ) + 1 != e * b->nodes[ node ].fan_in) {
+	flag_wait( b->release, e, b->spins );
+	return;
+      }
+    }
+    flag_set( b->release, e );
+    break;
+  }
+}
+
+void barrier_destroy( barrier_t *b )
+{
+  free( b->threads );
+  free( b->flags );
+  free( b->release );
+  free( b->partner );
+  free( b->nodes );
+  free( b->leaf );
+  free( b );
+}
+
+flags_t *flags_create( int n )
+{
+  flags_t *f = (flags_t *) malloc( sizeof(flags_t) );
+
+  f->spins = spins_for( n );
+  f->flag = (flag_t *) allocate( n, sizeof(flag_t) );
+  return f;
+}
+
+void flags_set( flags_t *f, int i, unsigned value )
+{
+  flag_set( &f->flag[ i ], value );
+}
+
+void flags_wait( flags_t *f, int i, unsigned target )
+{
+  flag_wait( &f->flag[ i ], target, f->spins );
+}
+
+void flags_destroy( flags_t *f )
+{
+  free( f->flag );
+  free( f );
+}
+
+int barrier_kind( const char *name )
+{
+  int kind;
+
+  for (kind = 0; kind < BARRIER_KINDS; ++kind) {
+    if (strcmp( name, names[ kind ] ) == 0)
+      return kind;
+  }
+  return -1;
+}
+
+const char *barrier_name( int kind )
+{
+  return ( kind >= 0 && kind < BARRIER_KINDS )? names[ kind ] : "unknown";
+}
@@ -0,0 +1,86 @@
+/**
+ * Barriers for a fixed team of threads numbered 0..n-1.
+ *
+ * Three algorithms (Mellor-Crummey & Scott, "Algorithms for scalable
+ * synchronization on shared-memory multiprocessors"):
+ *
+ * - BARRIER_DISSEMINATION: in round r thread i signals thread
+ *   (i + 2^r) mod n and waits for thread (i - 2^r) mod n; ceil(log2 n)
+ *   rounds, no thread waits for the others to be released.
+ * - BARRIER_TOURNAMENT: in round r the pairs (i, i + 2^r) with
+ *   i mod 2^(r+1) = 0 meet, the loser signals the winner and waits;
+ *   thread 0 wins the final and the winners wake their losers back down
+ *   the same tree.
+ * - BARRIER_TREE: combining tree of fan-in BARRIER_FAN_IN; the last
+ *   thread to arrive at a node goes on to its parent, the last one at
+ *   the root releases everybody through a single flag.
+ *
+ * Every flag has a cache line of its own and only counts up, so nothing
+ * is reset between episodes. Signals are C11 atomic read-modify-writes
+ * or stores and waits end with an acquire load, so everything written
+ * before the barrier is visible after it. A waiting thread polls its
+ * flag BARRIER_SPINS times and then sleeps on a futex. With more threads
+ * than CPUs it sleeps right away, since the thread it waits for may
+ * need its CPU.
+ *
+ * The same flags are also available on their own (flags_t), for
+ * threads that only wait for one neighbour instead of the whole team.
+ */
+#ifndef RB_BARRIER_H
+#define RB_BARRIER_H
+
+#define BARRIER_DISSEMINATION 0
+#define BARRIER_TOURNAMENT 1
+#define BARRIER_TREE 2
+#define BARRIER_KINDS 3
+
+#define BARRIER_FAN_IN 4 // children of a node of the combining tree
+#define BARRIER_SPINS 2000 // polls of a flag before sleeping on it
+
+typedef struct barrier barrier_t;
+
+/**
+ * Create a barrier of 'kind' for 'num_threads' threads; NULL for an
+ * unknown kind.
+ */
+barrier_t *barrier_create( int kind, int num_threads );
+
+/**
+ * Wait until all the threads have called barrier_wait(); 'id' is the
+ * number of the calling thread.
+ */
+void barrier_wait( barrier_t *b, int id );
+
+void barrier_destroy( barrier_t *b );
+
+/**
+ * Kind called 'name' ("dissemination", "tournament" or "tree"), -1 if
+ * there is none, and the other way round.
+ */
+int barrier_kind( const char *name );
+const char *barrier_name( int kind );
+
+typedef struct flags flags_t;
+
+/**
+ * Create 'n' flags, all 0, each on a cache line of its own, for a team
+ * of 'n' threads (which decides whether a waiter spins before it
+ * sleeps, as for the barriers).
+ */
+flags_t *flags_create( int n );
+
+/**
+ * Set flag 'i' to 'value' with a release store and wake its waiters.
+ */
+void flags_set( flags_t *f, int i, unsigned value );
+
+/**
+ * Wait until flag 'i' has reached 'target' (compared on the difference,
+ * so the values may wrap around); everything written before the
+ * flags_set() that reached it is then visible.
+ */
+void flags_wait( flags_t *f, int i, unsigned target );
+
+void flags_destroy( flags_t *f );
+
+#endif
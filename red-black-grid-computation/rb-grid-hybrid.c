@@ -6,12 +6,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <unistd.h>
 #include "mpi.h"
 #include "omp.h"
+#include "rb-split.h"
+#include "rb-sor.h"
+#include "rb-place.h"
 
 int num_nodes;
 int num_threads;
-int chunk_size = 10;
+int split = 0; // store the red and black points apart (rb-split.h)
+double tolerance = 0.0; // stop once max difference < tolerance (0: run num_iters)
+int check_every = 10; // iterations between two convergence checks
+double omega = 1.0; // SOR factor (rb-sor.h), 0 for the optimal one
+int chebyshev = 0; // change omega every half-sweep (Chebyshev acceleration)
+double *omegas = NULL; // omega of every half-sweep, NULL for Gauss-Seidel
+int multiple = 0; // edge threads do their own halo exchange (MPI_THREAD_MULTIPLE)
+MPI_Request halo_requests[4]; // persistent, see init_exchange()
+int num_halo_requests = 0;
+int num_up_requests = 0; // the first ones are with the rank above
+int interleave = 0; // spread the strip over all NUMA nodes (rb-place.h)
+int local_rank = 0; // my rank among the ranks on my node, for pinning
+int parity = 0; // 1 when the global row of my local row 0 is odd
 
 double **init_grid( int gridsize, int strip_size,
 		    int myrank, int num_nodes );
@@ -19,11 +36,11 @@ double **init_grid( int gridsize, int strip_size,
 void print_grid( double **grid, int myrank,
 		 int gridsize, int strip_size, int num_nodes );
 
-void compute_grid_red( double **grid, int gridsize, int strip_size, int myrank );
-void compute_grid_black( double **grid, int gridsize, int strip_size, int myrank );
-void exchange_rows( double **grid, int gridsize, int strip_size, int rank );
-double compute_grid_red_max( double **grid, int gridsize, int strip_size, int myrank );
-double compute_grid_black_max( double **grid, int gridsize, int strip_size, int myrank, double maxdiff );
+void thread_rows( int strip_size, int *lo, int *hi );
+void init_exchange( double **grid, int gridsize, int strip_size, int rank );
+void exchange_rows( void );
+double solve( double **grid, int gridsize, int strip_size, int myrank,
+	      int num_iters, int *iters );
 
 double MAX( double a, double b ) {
   return ( a > b )? a : b;
@@ -31,26 +48,85 @@ double MAX( double a, double b ) {
 
 int main(int argc, char *argv[])
 {
-  int myrank, gridsize, num_iters, err_code, strip_size, iter;
+  int myrank, gridsize, num_iters, err_code, strip_size, iter, row_len, opt, provided;
   double **grid;
   double start_time, end_time;
+  double maxdiff_global;
+  MPI_Comm node_comm;
+
+  while ((opt = getopt( argc, argv, "se:k:w:ctp:i" )) != -1) {
+    switch (opt) {
+    case 's':
+      split = 1;
+      break;
+    case 'e':
+      tolerance = atof( optarg );
+      break;
+    case 'k':
+      check_every = atoi( optarg );
+      break;
+    case 'w':
+      omega = strcmp( optarg, "auto" )? atof( optarg ) : 0.0;
+      break;
+    case 'c':
+      chebyshev = 1;
+      break;
+    case 't':
+      multiple = 1;
+      break;
+    case 'p':
+      if (place_cpus( optarg ) < 0)
+	argc = 0;
+      break;
+    case 'i':
+      interleave = 1;
+      break;
+    default:
+      argc = 0; // print the usage below
+    }
+  }
 
-  if (myrank == 0 && argc != 4) {
+  if (argc - optind != 3 || tolerance < 0.0 || check_every < 1 ||
+      omega < 0.0 || omega >= 2.0) {
     printf( "Please pass the right arguments!\n" );
-    printf( "Usage: mpirun -n <number of nodes> %s <gridsize> <number of iterations> <number of threads>\n", argv[0] );
+    printf( "Usage: mpirun -n <number of nodes> %s [-s] [-e tolerance [-k interval]]\n"
+	    "         [-w omega|auto] [-c] [-t] [-p cpus] [-i] <gridsize> <number of iterations> <number of threads>\n", argv[0] );
+    printf( "  -s  store red and black points in separate halves of each row\n" );
+    printf( "  -e  stop once the max difference is below 'tolerance', checked every\n"
+	    "      'interval' iterations (default %d); the number of iterations is the limit\n", check_every );
+    printf( "  -w  successive over-relaxation with 0 < omega < 2 ('auto': the optimal one)\n" );
+    printf( "  -c  Chebyshev acceleration: change omega every half-sweep\n" );
+    printf( "  -t  the threads owning the first and last row exchange them while the others\n"
+	    "      compute (needs MPI_THREAD_MULTIPLE)\n" );
+    printf( "  -p  pin thread k of the j-th rank on a node to the (j*threads+k)-th CPU\n"
+	    "      of 'cpus', e.g. 0-15 or 0,2,4,6\n" );
+    printf( "  -i  interleave the strip over all NUMA nodes instead of placing every\n"
+	    "      block of rows on the node of its thread (needs make NUMA=1)\n" );
     return -1;
   }
 
-  gridsize = atoi( argv[1] );
-  num_iters = atoi( argv[2] );
-  num_threads = atoi( argv[3] );
+  gridsize = atoi( argv[optind] );
+  num_iters = atoi( argv[optind+1] );
+  if (omega == 0.0)
+    omega = sor_optimal_omega( gridsize );
+  if (omega != 1.0 || chebyshev) // one more iteration for the max difference
+    omegas = sor_schedule( 2*num_iters + 2, omega, chebyshev, gridsize );
+  num_threads = atoi( argv[optind+2] );
 
   omp_set_dynamic( 0 ); // disable dynamic adjustment
   omp_set_num_threads(num_threads);  // OpenMP call to set the number of threads/rank
 
-  MPI_Init( NULL, NULL );
+  // the master thread (-t: the edge threads) calls MPI inside the parallel region
+  MPI_Init_thread( NULL, NULL, multiple? MPI_THREAD_MULTIPLE : MPI_THREAD_FUNNELED, &provided );
   MPI_Comm_size( MPI_COMM_WORLD, &num_nodes );
   MPI_Comm_rank( MPI_COMM_WORLD, &myrank );
+  MPI_Comm_split_type( MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm );
+  MPI_Comm_rank( node_comm, &local_rank );
+
+  if (myrank == 0 && provided < (multiple? MPI_THREAD_MULTIPLE : MPI_THREAD_FUNNELED)) {
+    fprintf( stderr, "the MPI library only provides thread level %d\n", provided );
+    MPI_Abort( MPI_COMM_WORLD, -1 );
+  }
 
   if (myrank == 0 && gridsize % num_nodes != 0) {
     MPI_Abort(MPI_COMM_WORLD, err_code);
@@ -62,120 +138,228 @@ int main(int argc, char *argv[])
   }
 
   strip_size = gridsize / num_nodes;
+  parity = (myrank * strip_size) % 2; // colors go by the global row, as in seq-rb
   grid = init_grid( gridsize+2, strip_size+2, myrank, num_nodes );
+  row_len = split? split_row_length( gridsize+2 ) : gridsize+2; // doubles per row
+  init_exchange( grid, row_len, strip_size+2, myrank );
 
-  for (iter = 0; iter < num_iters; ++iter) {
-    // compute red points
-    compute_grid_red( grid, gridsize+2, strip_size+2, myrank );
-    // send updates to neighbors
-    exchange_rows( grid, gridsize+2, strip_size+2, myrank );
-    // compute black points
-    compute_grid_black( grid, gridsize+2, strip_size+2, myrank );
-    // send updates to neighbors
-    exchange_rows( grid, gridsize+2, strip_size+2, myrank );
-  }
-
-  double maxdiff, maxdiff_global;
-  maxdiff = compute_grid_red_max( grid, gridsize+2, strip_size+2, myrank );
-  exchange_rows( grid, gridsize+2, strip_size+2, myrank );
-  maxdiff = compute_grid_black_max( grid, gridsize+2, strip_size+2, myrank, maxdiff );
-
-  MPI_Reduce(&maxdiff, &maxdiff_global, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  maxdiff_global = solve( grid, gridsize+2, strip_size+2, myrank, num_iters, &iter );
   //print_grid( grid, myrank, gridsize+2, strip_size+2, num_nodes );
 
   // stop timer
   if (myrank == 0) {
     end_time = MPI_Wtime();
-    printf( "Number of MPI ranks: %d\tNumber of threads: %d\tExecution time:%.3lf sec\tMax difference:%lf\n",
+    printf( "Number of MPI ranks: %d\tNumber of threads: %d\tExecution time:%.3lf sec\tMax difference:%lf",
 	    num_nodes, num_threads, end_time-start_time, maxdiff_global);
+    if (tolerance > 0.0)
+      printf( "\tIterations:%d", iter-1 );
+    putchar( '\n' );
   }
-  
-  MPI_Finalize();
-}
 
-void compute_grid_red( double **grid, int gridsize, int strip_size, int myrank )
-{
-  int i, j, jstart;
-
-#pragma omp parallel for shared(grid,num_threads) private(i,j,jstart) schedule (static, chunk_size)
-  for (i = 1; i < strip_size-1; i++) {
-    if (i % 2 == 1) jstart = 1; // odd row
-    else jstart = 2; // even row
-    
-    for (j = jstart; j < gridsize-1; j += 2) {
-      grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
-			 grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
-    }
+  for (iter = 0; iter < num_halo_requests; ++iter) {
+    MPI_Request_free( &halo_requests[ iter ] );
   }
+  MPI_Finalize();
 }
 
-double compute_grid_red_max( double **grid, int gridsize, int strip_size, int myrank )
+/**
+ * Set up the halo exchange of my strip once, as persistent requests:
+ * receive rows 0 and strip_size-1 from the neighbours and send them rows
+ * 1 and strip_size-2.
+ *
+ * The exchange used to be MPI_Send to both neighbours followed by
+ * MPI_Recv. Once a row is larger than the eager limit of the MPI library
+ * (4 KB for shared memory in Open MPI, i.e. a gridsize of about 500) an
+ * MPI_Send waits for the matching receive, and neighbours that both send
+ * first deadlock (see the comment in rb-grid-mpi.c). With all four
+ * requests started together nobody waits for anybody before receiving.
+ */
+void init_exchange( double **grid, int gridsize, int strip_size, int rank )
 {
-  int i, j, jstart;
-  double old, maxdiff = 0.0;
-
-  for (i = 1; i < strip_size-1; i++) {
-    if (i % 2 == 1) jstart = 1; // odd row
-    else jstart = 2; // even row
-    
-    for (j = jstart; j < gridsize-1; j += 2) {
-      old = grid[ i ][ j ];
-      grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
-			 grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
-      maxdiff = MAX( maxdiff, fabs(old - grid[i][j]) );
-    }
+  if (rank != 0) {
+    MPI_Recv_init( grid[0], gridsize, MPI_DOUBLE, rank-1, 0, MPI_COMM_WORLD,
+		   &halo_requests[ num_halo_requests++ ] );
+    MPI_Send_init( grid[1], gridsize, MPI_DOUBLE, rank-1, 0, MPI_COMM_WORLD,
+		   &halo_requests[ num_halo_requests++ ] );
+  }
+  num_up_requests = num_halo_requests;
+  if (rank != num_nodes-1) {
+    MPI_Recv_init( grid[strip_size-1], gridsize, MPI_DOUBLE, rank+1, 0, MPI_COMM_WORLD,
+		   &halo_requests[ num_halo_requests++ ] );
+    MPI_Send_init( grid[strip_size-2], gridsize, MPI_DOUBLE, rank+1, 0, MPI_COMM_WORLD,
+		   &halo_requests[ num_halo_requests++ ] );
   }
-  //printf( "rank %d maxdiff: %lf\n", myrank, maxdiff);
-  return maxdiff;
 }
 
-void compute_grid_black( double **grid, int gridsize, int strip_size, int myrank )
+/**
+ * Exchange the edge rows of my strip with the neighbours (init_exchange()
+ * must have been called).
+ */
+void exchange_rows( void )
 {
-  int i, j, jstart;
-
-#pragma omp parallel for shared(grid,num_threads) private(i,j,jstart) schedule (static, chunk_size)
-  for (i = 1; i < strip_size-1; i++) {
-    if (i % 2 == 1) jstart = 2; // odd row
-    else jstart = 1; // even row
-    
-    for (j = jstart; j < gridsize-1; j += 2) {
-      grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
-			 grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
-    }
-  }
+  MPI_Startall( num_halo_requests, halo_requests );
+  MPI_Waitall( num_halo_requests, halo_requests, MPI_STATUSES_IGNORE );
 }
 
-double compute_grid_black_max( double **grid, int gridsize, int strip_size, int myrank, double maxdiff )
+/**
+ * Update the 'color' points of local row i in iteration 'iter' and
+ * return the max of 'maxdiff' and their changes (only computed with
+ * 'check'). The color of a point goes by its global row (see parity).
+ */
+double update_row( double **grid, int i, int gridsize, int color, int iter, int check,
+		   double maxdiff )
 {
-  int i, j, jstart;
+  int j;
   double old;
 
-  for (i = 1; i < strip_size-1; i++) {
-    if (i % 2 == 1) jstart = 2; // odd row
-    else jstart = 1; // even row
-    
-    for (j = jstart; j < gridsize-1; j += 2) {
-      old = grid[ i ][ j ];
+  if (omegas) {
+    if (check)
+      return sor_update_row_max( grid, i, gridsize, color ^ parity, omegas[ 2*(iter-1) + color ], split, maxdiff );
+    sor_update_row( grid, i, gridsize, color ^ parity, omegas[ 2*(iter-1) + color ], split );
+    return maxdiff;
+  }
+
+  if (split) {
+    if (check)
+      return split_update_row_max( grid, i, gridsize, color ^ parity, maxdiff );
+    split_update_row( grid, i, gridsize, color ^ parity );
+    return maxdiff;
+  }
+
+  if (!check) {
+    for (j = 2 - (i + parity + color) % 2; j < gridsize-1; j += 2) {
       grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
 			 grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
-      maxdiff = MAX( maxdiff, fabs(old - grid[i][j]) );
     }
+    return maxdiff;
   }
 
-  //printf( "rank %d maxdiff: %lf\n", myrank, maxdiff);
+  for (j = 2 - (i + parity + color) % 2; j < gridsize-1; j += 2) {
+    old = grid[ i ][ j ];
+    grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
+		       grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
+    maxdiff = MAX( maxdiff, fabs(old - grid[i][j]) );
+  }
   return maxdiff;
 }
 
-void exchange_rows( double **grid, int gridsize, int strip_size, int rank )
+/**
+ * First and last+1 row of my strip that the calling thread updates (and
+ * touches first in init_grid()): one block of nearly equal size per
+ * thread of the parallel region.
+ */
+void thread_rows( int strip_size, int *lo, int *hi )
+{
+  int rows = strip_size-2, t = omp_get_thread_num(), T = omp_get_num_threads();
+
+  *lo = 1 + (int) ((long) rows * t / T);
+  *hi = 1 + (int) ((long) rows * (t+1) / T);
+}
+
+/**
+ * Run all iterations (and the last sweep for the max difference) in one
+ * parallel region and return the max difference.
+ *
+ * Every thread keeps its block of rows (thread_rows()) for the whole
+ * run, so the rows it updates are the ones it touched first. The colors
+ * are separated by barriers. By default the master thread exchanges the
+ * halo rows between two barriers (MPI_THREAD_FUNNELED).
+ *
+ * With -t the owner of the first row updates it first, starts the
+ * exchange with the rank above (halo_requests[0..num_up_requests)) and
+ * only waits for it after the rest of its block; the owner of the last
+ * row does the same with the rank below. So the halo rows travel while
+ * all threads compute.
+ *
+ * The max difference is merged from all threads and reduced with
+ * MPI_Iallreduce by the master thread, completed after the next
+ * iteration; '*iters' is set to the iteration after the last one run.
+ */
+double solve( double **grid, int gridsize, int strip_size, int myrank,
+	      int num_iters, int *iters )
 {
-  if (rank != 0)
-    MPI_Send( grid[1], gridsize, MPI_DOUBLE, rank-1, 0, MPI_COMM_WORLD );
-  if (rank != num_nodes-1)
-    MPI_Send( grid[strip_size-2], gridsize, MPI_DOUBLE, rank+1, 0, MPI_COMM_WORLD );
-  if (rank != 0)
-    MPI_Recv( grid[0], gridsize, MPI_DOUBLE, rank-1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
-  if (rank != num_nodes-1)
-    MPI_Recv( grid[strip_size-1], gridsize, MPI_DOUBLE, rank+1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
+  int last_iter, pending = 0, converged = 0;
+  double maxdiff = 0.0, maxdiff_global = 0.0, mydiff = 0.0;
+  MPI_Request request;
+
+  last_iter = ( tolerance == 0.0 )? num_iters+1 : num_iters;
+
+#pragma omp parallel shared(grid,pending,converged,maxdiff,maxdiff_global,mydiff,request)
+  {
+    int lo, hi, top, bottom, iter, color, check, sync, first, last, i;
+    double local;
+
+    thread_rows( strip_size, &lo, &hi );
+    top = ( multiple && lo == 1 && lo < hi );
+    bottom = ( multiple && hi == strip_size-1 && lo < hi );
+
+    for (iter = 1; iter <= last_iter && !converged; ++iter) {
+      check = ( iter == num_iters+1 ||
+		(tolerance > 0.0 && (iter % check_every == 0 || iter == num_iters)) );
+      sync = ( pending || check ); // before the master thread can change 'pending'
+      local = 0.0;
+      for (color = RED; color <= BLACK; ++color) {
+	first = lo;
+	last = hi;
+	if (top)
+	  local = update_row( grid, first++, gridsize, color, iter, check, local );
+	if (bottom && first < last)
+	  local = update_row( grid, --last, gridsize, color, iter, check, local );
+	if (top)
+	  MPI_Startall( num_up_requests, halo_requests );
+	if (bottom)
+	  MPI_Startall( num_halo_requests - num_up_requests, &halo_requests[ num_up_requests ] );
+
+	for (i = first; i < last; ++i) {
+	  local = update_row( grid, i, gridsize, color, iter, check, local );
+	}
+
+	if (top)
+	  MPI_Waitall( num_up_requests, halo_requests, MPI_STATUSES_IGNORE );
+	if (bottom)
+	  MPI_Waitall( num_halo_requests - num_up_requests, &halo_requests[ num_up_requests ],
+		       MPI_STATUSES_IGNORE );
+#pragma omp barrier
+	if (!multiple) {
+#pragma omp master
+	  exchange_rows();
+#pragma omp barrier
+	}
+      }
+
+      if (check) {
+#pragma omp critical
+	mydiff = MAX( mydiff, local );
+#pragma omp barrier
+      }
+      if (iter == num_iters+1) {
+#pragma omp master
+	MPI_Reduce( &mydiff, &maxdiff_global, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD );
+      } else if (sync) {
+#pragma omp master
+	{
+	  if (pending) {
+	    MPI_Wait( &request, MPI_STATUS_IGNORE );
+	    pending = 0;
+	    converged = ( maxdiff_global < tolerance );
+	  }
+	  if (check && !converged) {
+	    maxdiff = mydiff; // the send buffer must not change while in flight
+	    MPI_Iallreduce( &maxdiff, &maxdiff_global, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD, &request );
+	    pending = 1;
+	  }
+	  mydiff = 0.0;
+	}
+#pragma omp barrier
+      }
+    }
+#pragma omp master
+    *iters = ( tolerance == 0.0 )? num_iters+1 : iter;
+  }
+  if (pending)
+    MPI_Wait( &request, MPI_STATUS_IGNORE );
+
+  return maxdiff_global;
 }
 
 void print_grid( double **grid, int myrank,
@@ -187,44 +371,70 @@ void print_grid( double **grid, int myrank,
   for (i = 0; i < strip_size; ++i) {
     printf( "row %d: ", i );
     for (j = 0; j < gridsize; ++j) {
-      printf( "%lf ", grid[ i ][ j ] );
+      printf( "%lf ", split? split_get( grid, i, j, gridsize ) : grid[ i ][ j ] );
     }
     putchar('\n');
   }
 }
 
+/**
+ * Allocate my strip and initialize it in a parallel region, every thread
+ * its own rows of solve() (and thread 0 and the last thread the halo
+ * rows), so that the pages of a row are placed near the thread that
+ * updates it. This is the first parallel region, so the threads are
+ * pinned (-p) here; with -i the pages are interleaved instead.
+ */
 double **init_grid( int gridsize, int strip_size,
 		    int myrank, int num_nodes )
 {
-  int i, j;
+  int i, row_len;
   double ** outer_ptr;
   double *vals; // to allocate a contiguously array
 
-  vals = (double *) malloc( gridsize * strip_size * sizeof(double) );
-  outer_ptr = (double **) malloc( strip_size * sizeof(double*) );
+  if (split) {
+    outer_ptr = split_allocate_grid( strip_size, gridsize );
+  } else {
+    vals = (double *) malloc( (size_t) gridsize * strip_size * sizeof(double) );
+    outer_ptr = (double **) malloc( strip_size * sizeof(double*) );
 
-  for (i = 0; i < strip_size; ++i) {
-    outer_ptr[ i ] = &(vals[i * gridsize]);
-  }
-
-  for (i = 0; i < strip_size; ++i) {
-    for (j = 0; j < gridsize; ++j) {
-      if (j == 0 || j == (gridsize-1))
-	outer_ptr[ i ][ j ] = 1.0;
-      else
-	outer_ptr[ i ][ j ] = 0.0;
+    for (i = 0; i < strip_size; ++i) {
+      outer_ptr[ i ] = &(vals[(size_t) i * gridsize]);
     }
   }
-
-  if (myrank == 0) {
-    for (j = 0; j < gridsize; ++j) {
-      outer_ptr[ 0 ][ j ] = 1.0;
-    }
+  row_len = split? split_row_length( gridsize ) : gridsize;
+  if (interleave && place_interleave( outer_ptr[0], (size_t) strip_size * row_len * sizeof(double) ) != 0) {
+    fprintf( stderr, "-i needs libnuma and a NUMA kernel (make NUMA=1)\n" );
+    MPI_Abort( MPI_COMM_WORLD, -1 );
   }
 
-  if (myrank == num_nodes-1) {
-    for (j = 0; j < gridsize; ++j) {
-      outer_ptr[ strip_size-1 ][ j ] = 1.0;
+#pragma omp parallel shared(outer_ptr) private(i)
+  {
+    int lo, hi, j;
+    double inner;
+
+    place_pin( local_rank * omp_get_num_threads() + omp_get_thread_num() );
+    thread_rows( strip_size, &lo, &hi );
+    if (omp_get_thread_num() == 0)
+      lo = 0;
+    if (omp_get_thread_num() == omp_get_num_threads()-1)
+      hi = strip_size;
+
+    for (i = lo; i < hi; ++i) {
+      if ((myrank == 0 && i == 0) || (myrank == num_nodes-1 && i == strip_size-1))
+	inner = 1.0;
+      else
+	inner = 0.0;
+
+      if (split) {
+	split_fill_row( outer_ptr[ i ], gridsize, 1.0, inner );
+	continue;
+      }
+      for (j = 0; j < gridsize; ++j) {
+	if (j == 0 || j == (gridsize-1))
+	  outer_ptr[ i ][ j ] = 1.0;
+	else
+	  outer_ptr[ i ][ j ] = inner;
+      }
     }
   }
 
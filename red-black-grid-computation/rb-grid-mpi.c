@@ -8,91 +8,297 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "rb-split.h"
+#include "rb-sor.h"
+#include "rb-mg.h"
+
+#define MG_STRIP_ROWS 8 // coarser levels with fewer rows on some rank are gathered on rank 0
+#define ROWS_PER_TEST 64 // interior rows updated between two MPI_Testall
+
+/**
+ * A multigrid level (rb-mg.h) cut into row strips: rank p owns the
+ * global interior rows first[p] .. first[p]+count[p]-1 and keeps them
+ * with one halo row above and below. A row of the next coarser level
+ * belongs to the rank that owns the first fine row at or after it, so
+ * restriction and interpolation reach only one row into the
+ * neighbouring strips.
+ */
+typedef struct {
+  int n; // interior points per side
+  int *first, *count; // of every rank
+  double **u, **b, **r; // b is NULL on level 0
+  mg_transfer up; // interpolation from the level below
+} strip_level;
 
 int num_nodes;
+int split = 0; // store the red and black points apart (rb-split.h)
+double tolerance = 0.0; // stop once max difference < tolerance (0: run num_iters)
+int check_every = 10; // iterations between two convergence checks
+double omega = 1.0; // SOR factor (rb-sor.h), 0 for the optimal one
+int chebyshev = 0; // change omega every half-sweep (Chebyshev acceleration)
+double *omegas = NULL; // omega of every half-sweep, NULL for Gauss-Seidel
+int cycle = 0; // multigrid: 1 for V-cycles, 2 for W-cycles
+strip_level levels[ MG_MAX_LEVELS ]; // the levels on the strips
+int nlevels = 0;
+int gather = 0; // whether the levels below those are solved on rank 0
+mg_level gathered[ MG_MAX_LEVELS ]; // rank 0: the levels below, sequentially
+int ngathered = 0;
+int *gather_counts, *gather_displs; // doubles of the last strip level on every rank
+int blocks = 0; // 2-D blocks over a Cartesian grid of ranks instead of row strips
+int dims[2] = { 0, 0 }, coords[2]; // shape of the grid of ranks and my place in it
+int north, south, west, east; // my neighbours, MPI_PROC_NULL on the boundary
+MPI_Comm cart_comm;
+MPI_Datatype column_type; // one column of my block, without the halo rows
+int parity = 0; // 1 when global row + column of my local point (0,0) is odd
+int color_halo = 0; // row strips send only the color just updated
+MPI_Datatype half_row[2]; // the even and the odd columns of a row
+double halo_bytes = 0.0; // sent by this rank in halo exchanges
+double halo_time = 0.0; // spent by this rank in halo exchanges
+int depth = 1; // ghost rows on either side of a row strip
+long half_steps = 0; // half-sweeps done, for the deep halo schedule
 
 double **init_grid( int gridsize, int strip_size,
 		    int myrank, int num_nodes );
+double **init_block( int rows, int cols );
 
 void print_grid( double **grid, int myrank,
 		 int gridsize, int strip_size, int num_nodes );
 
-void compute_grid_red( double **grid, int gridsize, int strip_size, int myrank );
-void compute_grid_black( double **grid, int gridsize, int strip_size, int myrank );
+void compute_grid_red( double **grid, int gridsize, int first, int last, int iter );
+void compute_grid_black( double **grid, int gridsize, int first, int last, int iter );
 void exchange_rows( double **grid, int gridsize, int strip_size, int rank );
-double compute_grid_red_max( double **grid, int gridsize, int strip_size, int myrank );
-double compute_grid_black_max( double **grid, int gridsize, int strip_size, int myrank, double maxdiff );
+void exchange_halo( double **grid, int row_len, int strip_size, int rank );
+double half_sweep( double **grid, int cols, int row_len, int strip_size, int rank,
+		   int color, int iter, int check, double maxdiff );
+void init_half_rows( int cols );
+void exchange_deep( double **grid, int row_len, int strip_size, int rank );
+double compute_grid_red_max( double **grid, int gridsize, int first, int last, int iter );
+double compute_grid_black_max( double **grid, int gridsize, int first, int last, int iter,
+			       double maxdiff );
+void accumulate_rows( double **grid, int gridsize, int strip_size, int rank );
+void mg_strip_setup( double **grid, int gridsize, int strip_size, int myrank );
+void mg_strip_cycle( int l, int myrank );
 
 double MAX( double a, double b ) {
   return ( a > b )? a : b;
 }
 
+/*
+ * First index of block 'b' when 'size' indices are split into 'nblocks'
+ * nearly equal blocks. Block b covers [block_start(b), block_start(b+1)).
+ */
+int block_start( int size, int nblocks, int b )
+{
+  return (int) ((long) size * b / nblocks);
+}
+
 int main(int argc, char *argv[])
 {
-  int myrank, gridsize, num_iters, err_code, strip_size, iter;
+  int myrank, gridsize, num_iters, err_code, strip_size, iter, row_len, opt;
+  int cols, row_start, col_start, periods[2] = { 0, 0 };
+  int check, pending = 0, converged = 0;
   double **grid;
   double start_time, end_time;
+  double maxdiff, maxdiff_global, mydiff, halo[2], halo_max[2];
+  MPI_Request request;
+
+  while ((opt = getopt( argc, argv, "se:k:w:cm:bxd:" )) != -1) {
+    switch (opt) {
+    case 's':
+      split = 1;
+      break;
+    case 'e':
+      tolerance = atof( optarg );
+      break;
+    case 'k':
+      check_every = atoi( optarg );
+      break;
+    case 'w':
+      omega = strcmp( optarg, "auto" )? atof( optarg ) : 0.0;
+      break;
+    case 'c':
+      chebyshev = 1;
+      break;
+    case 'm':
+      cycle = ( optarg[0] == 'W' || optarg[0] == 'w' )? 2 : 1;
+      break;
+    case 'b':
+      blocks = 1;
+      break;
+    case 'x':
+      color_halo = 1;
+      break;
+    case 'd':
+      depth = atoi( optarg );
+      break;
+    default:
+      argc = 0; // print the usage below
+    }
+  }
 
-  if (argc != 3) {
+  if (argc - optind != 2 || tolerance < 0.0 || check_every < 1 ||
+      omega < 0.0 || omega >= 2.0 || (cycle && (split || omega != 1.0 || chebyshev)) ||
+      (blocks && (split || cycle || color_halo)) ||
+      depth < 1 || (depth > 1 && (blocks || cycle || color_halo))) {
     printf( "Please pass the right arguments!\n" );
-    printf( "Usage: mpirun -n <number of nodes> %s <gridsize> <number of iterations>\n", argv[0] );
+    printf( "Usage: mpirun -n <number of nodes> %s [-s] [-e tolerance [-k interval]]\n"
+	    "         [-w omega|auto] [-c] [-m V|W] [-b] [-x] [-d depth]\n"
+	    "         <gridsize> <number of iterations>\n", argv[0] );
+    printf( "  -s  store red and black points in separate halves of each row\n" );
+    printf( "  -e  stop once the max difference is below 'tolerance', checked every\n"
+	    "      'interval' iterations (default %d); the number of iterations is the limit\n", check_every );
+    printf( "  -w  successive over-relaxation with 0 < omega < 2 ('auto': the optimal one)\n" );
+    printf( "  -c  Chebyshev acceleration: change omega every half-sweep\n" );
+    printf( "  -m  one multigrid V- or W-cycle per iteration (not with -s, -w, -c)\n" );
+    printf( "  -b  2-D blocks over a grid of ranks instead of row strips (not with -s, -m, -x)\n" );
+    printf( "  -x  halo exchanges of the row strips send only the color just updated\n" );
+    printf( "  -d  keep 'depth' ghost rows on either side of a row strip and exchange them\n"
+	    "      every 'depth' half-sweeps (not with -b, -m, -x)\n" );
     return -1;
   }
 
-  gridsize = atoi( argv[1] );
-  num_iters = atoi( argv[2] );
+  gridsize = atoi( argv[optind] );
+  num_iters = atoi( argv[optind+1] );
+  if (omega == 0.0)
+    omega = sor_optimal_omega( gridsize );
+  if (omega != 1.0 || chebyshev) // one more iteration for the max difference
+    omegas = sor_schedule( 2*num_iters + 2, omega, chebyshev, gridsize );
 
   MPI_Init( NULL, NULL );
   MPI_Comm_size( MPI_COMM_WORLD, &num_nodes );
   MPI_Comm_rank( MPI_COMM_WORLD, &myrank );
 
-  if (myrank == 0 && gridsize % num_nodes != 0) {
+  if (blocks) { // the ranks form a pr x pc Cartesian grid
+    MPI_Dims_create( num_nodes, 2, dims );
+    MPI_Cart_create( MPI_COMM_WORLD, 2, dims, periods, 1, &cart_comm );
+    MPI_Comm_rank( cart_comm, &myrank );
+    MPI_Cart_coords( cart_comm, myrank, 2, coords );
+    MPI_Cart_shift( cart_comm, 0, 1, &north, &south );
+    MPI_Cart_shift( cart_comm, 1, 1, &west, &east );
+    MPI_Comm_rank( MPI_COMM_WORLD, &myrank );
+  }
+
+  if (myrank == 0 && !blocks && gridsize % num_nodes != 0) {
     MPI_Abort(MPI_COMM_WORLD, err_code);
   }
+  if (myrank == 0 && depth > gridsize / num_nodes) {
+    fprintf( stderr, "halo depth %d is larger than the strips of %d rows\n", depth, gridsize / num_nodes );
+    MPI_Abort( MPI_COMM_WORLD, -1 );
+  }
+  if (myrank == 0 && blocks && (gridsize < dims[0] || gridsize < dims[1])) {
+    fprintf( stderr, "gridsize %d is too small for a %dx%d grid of ranks\n", gridsize, dims[0], dims[1] );
+    MPI_Abort( MPI_COMM_WORLD, -1 );
+  }
 
   // start timer
   if (myrank == 0) {
     start_time = MPI_Wtime();
   }
 
-  strip_size = gridsize / num_nodes;
-  grid = init_grid( gridsize+2, strip_size+2, myrank, num_nodes );
+  if (blocks) {
+    /* My block: global rows row_start+1 .. row_start+strip_size and
+       columns col_start+1 .. col_start+cols-2. */
+    row_start = block_start( gridsize, dims[0], coords[0] );
+    col_start = block_start( gridsize, dims[1], coords[1] );
+    strip_size = block_start( gridsize, dims[0], coords[0]+1 ) - row_start;
+    cols = block_start( gridsize, dims[1], coords[1]+1 ) - col_start + 2;
+    parity = (row_start + col_start) % 2;
+    grid = init_block( strip_size, cols-2 );
+    MPI_Type_vector( strip_size, 1, cols, MPI_DOUBLE, &column_type );
+    MPI_Type_commit( &column_type );
+    row_len = cols;
+  } else {
+    strip_size = gridsize / num_nodes;
+    cols = gridsize+2;
+    parity = (myrank * strip_size) % 2; // colors go by the global row, as in seq-rb
+    grid = init_grid( gridsize+2, strip_size+2, myrank, num_nodes );
+    row_len = split? split_row_length( gridsize+2 ) : gridsize+2; // doubles per row
+    init_half_rows( cols );
+  }
+  if (cycle)
+    mg_strip_setup( grid, gridsize, strip_size, myrank );
+
+  /* With a tolerance every 'check_every'-th and the last iteration also
+     compute the local max difference and start reducing it with
+     MPI_Iallreduce. The reduction is completed after the next iteration,
+     so it overlaps with those sweeps and the run goes at most one
+     iteration past the one that converged. With -m the iteration is a
+     multigrid cycle and the check is an extra sweep after it. */
+  for (iter = 1; iter <= num_iters && !converged; ++iter) {
+    check = ( tolerance > 0.0 && (iter % check_every == 0 || iter == num_iters) );
+    if (cycle)
+      mg_strip_cycle( 0, myrank );
+    if (check || !cycle) {
+      // compute red points and send updates to neighbors
+      mydiff = half_sweep( grid, cols, row_len, strip_size+2, myrank, RED, iter, check, 0.0 );
+      // compute black points and send updates to neighbors
+      mydiff = half_sweep( grid, cols, row_len, strip_size+2, myrank, BLACK, iter, check, mydiff );
+    }
 
-  for (iter = 0; iter < num_iters; ++iter) {
-    // compute red points
-    compute_grid_red( grid, gridsize+2, strip_size+2, myrank );
-    // send updates to neighbors
-    exchange_rows( grid, gridsize+2, strip_size+2, myrank );
-    // compute black points
-    compute_grid_black( grid, gridsize+2, strip_size+2, myrank );
-    // send updates to neighbors
-    exchange_rows( grid, gridsize+2, strip_size+2, myrank );
+    if (pending) {
+      MPI_Wait( &request, MPI_STATUS_IGNORE );
+      pending = 0;
+      converged = ( maxdiff_global < tolerance );
+    }
+    if (check && !converged) {
+      maxdiff = mydiff; // the send buffer must not change while in flight
+      MPI_Iallreduce( &maxdiff, &maxdiff_global, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD, &request );
+      pending = 1;
+    }
   }
+  if (pending)
+    MPI_Wait( &request, MPI_STATUS_IGNORE );
 
-  double maxdiff, maxdiff_global;
-  maxdiff = compute_grid_red_max( grid, gridsize+2, strip_size+2, myrank );
-  exchange_rows( grid, gridsize+2, strip_size+2, myrank );
-  maxdiff = compute_grid_black_max( grid, gridsize+2, strip_size+2, myrank, maxdiff );
+  if (tolerance == 0.0) {
+    maxdiff = half_sweep( grid, cols, row_len, strip_size+2, myrank, RED, num_iters+1, 1, 0.0 );
+    maxdiff = half_sweep( grid, cols, row_len, strip_size+2, myrank, BLACK, num_iters+1, 1, maxdiff );
 
-  MPI_Reduce(&maxdiff, &maxdiff_global, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&maxdiff, &maxdiff_global, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  }
   //print_grid( grid, myrank, gridsize+2, strip_size+2, num_nodes );
 
+  halo[0] = halo_bytes;
+  halo[1] = halo_time;
+  MPI_Reduce( halo, halo_max, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD );
+
   // stop timer
   if (myrank == 0) {
     end_time = MPI_Wtime();
-    printf( "Number of MPI ranks: %d\tNumber of threads: 0\tExecution time:%.3lf sec\tMax difference:%lf\n",
+    printf( "Number of MPI ranks: %d\tNumber of threads: 0\tExecution time:%.3lf sec\tMax difference:%lf",
 	    num_nodes, end_time-start_time, maxdiff_global);
+    if (tolerance > 0.0)
+      printf( "\tIterations:%d", iter-1 );
+    if (blocks)
+      printf( "\tProcess grid: %dx%d", dims[0], dims[1] );
+    printf( "\tHalo per rank:%.2lf MB in %.3lf sec", halo_max[0] / 1048576, halo_max[1] );
+    putchar( '\n' );
   }
   
   MPI_Finalize();
 }
 
-void compute_grid_red( double **grid, int gridsize, int strip_size, int myrank )
+void compute_grid_red( double **grid, int gridsize, int first, int last, int iter )
 {
   int i, j, jstart;
 
-  for (i = 1; i < strip_size-1; i++) {
-    if (i % 2 == 1) jstart = 1; // odd row
+  if (omegas) {
+    for (i = first; i <= last; i++) {
+      sor_update_row( grid, i, gridsize, RED ^ parity, omegas[ 2*(iter-1) ], split );
+    }
+    return;
+  }
+
+  if (split) {
+    for (i = first; i <= last; i++) {
+      split_update_row( grid, i, gridsize, RED ^ parity );
+    }
+    return;
+  }
+
+  for (i = first; i <= last; i++) {
+    if ((i + parity) % 2 != 0) jstart = 1; // odd row
     else jstart = 2; // even row
     
     for (j = jstart; j < gridsize-1; j += 2) {
@@ -102,13 +308,27 @@ void compute_grid_red( double **grid, int gridsize, int strip_size, int myrank )
   }
 }
 
-double compute_grid_red_max( double **grid, int gridsize, int strip_size, int myrank )
+double compute_grid_red_max( double **grid, int gridsize, int first, int last, int iter )
 {
   int i, j, jstart;
   double old, maxdiff = 0.0;
 
-  for (i = 1; i < strip_size-1; i++) {
-    if (i % 2 == 1) jstart = 1; // odd row
+  if (omegas) {
+    for (i = first; i <= last; i++) {
+      maxdiff = sor_update_row_max( grid, i, gridsize, RED ^ parity, omegas[ 2*(iter-1) ], split, maxdiff );
+    }
+    return maxdiff;
+  }
+
+  if (split) {
+    for (i = first; i <= last; i++) {
+      maxdiff = split_update_row_max( grid, i, gridsize, RED ^ parity, maxdiff );
+    }
+    return maxdiff;
+  }
+
+  for (i = first; i <= last; i++) {
+    if ((i + parity) % 2 != 0) jstart = 1; // odd row
     else jstart = 2; // even row
     
     for (j = jstart; j < gridsize-1; j += 2) {
@@ -122,12 +342,26 @@ double compute_grid_red_max( double **grid, int gridsize, int strip_size, int my
   return maxdiff;
 }
 
-void compute_grid_black( double **grid, int gridsize, int strip_size, int myrank )
+void compute_grid_black( double **grid, int gridsize, int first, int last, int iter )
 {
   int i, j, jstart;
 
-  for (i = 1; i < strip_size-1; i++) {
-    if (i % 2 == 1) jstart = 2; // odd row
+  if (omegas) {
+    for (i = first; i <= last; i++) {
+      sor_update_row( grid, i, gridsize, BLACK ^ parity, omegas[ 2*(iter-1) + 1 ], split );
+    }
+    return;
+  }
+
+  if (split) {
+    for (i = first; i <= last; i++) {
+      split_update_row( grid, i, gridsize, BLACK ^ parity );
+    }
+    return;
+  }
+
+  for (i = first; i <= last; i++) {
+    if ((i + parity) % 2 != 0) jstart = 2; // odd row
     else jstart = 1; // even row
     
     for (j = jstart; j < gridsize-1; j += 2) {
@@ -137,13 +371,28 @@ void compute_grid_black( double **grid, int gridsize, int strip_size, int myrank
   }
 }
 
-double compute_grid_black_max( double **grid, int gridsize, int strip_size, int myrank, double maxdiff )
+double compute_grid_black_max( double **grid, int gridsize, int first, int last, int iter,
+			       double maxdiff )
 {
   int i, j, jstart;
   double old;
 
-  for (i = 1; i < strip_size-1; i++) {
-    if (i % 2 == 1) jstart = 2; // odd row
+  if (omegas) {
+    for (i = first; i <= last; i++) {
+      maxdiff = sor_update_row_max( grid, i, gridsize, BLACK ^ parity, omegas[ 2*(iter-1) + 1 ], split, maxdiff );
+    }
+    return maxdiff;
+  }
+
+  if (split) {
+    for (i = first; i <= last; i++) {
+      maxdiff = split_update_row_max( grid, i, gridsize, BLACK ^ parity, maxdiff );
+    }
+    return maxdiff;
+  }
+
+  for (i = first; i <= last; i++) {
+    if ((i + parity) % 2 != 0) jstart = 2; // odd row
     else jstart = 1; // even row
     
     for (j = jstart; j < gridsize-1; j += 2) {
@@ -194,6 +443,7 @@ void exchange_rows( double **grid, int gridsize, int strip_size, int rank )
   MPI_Request request_up;
   MPI_Request request_down;
   MPI_Status  status;
+  double t = MPI_Wtime();
 
   if (rank != 0) {
     MPI_Isend( grid[1], gridsize, MPI_DOUBLE, rank-1, 0, MPI_COMM_WORLD, &request_up );
@@ -212,6 +462,372 @@ void exchange_rows( double **grid, int gridsize, int strip_size, int rank )
   if (rank != num_nodes-1) {
     MPI_Wait( &request_down, &status );
   }
+  halo_bytes += ( (rank != 0) + (rank != num_nodes-1) ) * gridsize * sizeof(double);
+  halo_time += MPI_Wtime() - t;
+}
+
+/**
+ * Set up half_row[]: the even (0) and the odd (1) columns of a row of
+ * 'cols' columns, every other double in the interleaved layout and one
+ * half of the row in the split layout. Each includes the boundary
+ * column on its side, which holds the same value on every rank.
+ */
+void init_half_rows( int cols )
+{
+  int odd;
+
+  for (odd = 0; odd < 2; ++odd) {
+    if (split)
+      MPI_Type_contiguous( split_half( cols ), MPI_DOUBLE, &half_row[ odd ] );
+    else
+      MPI_Type_vector( (cols - odd + 1) / 2, 1, 2, MPI_DOUBLE, &half_row[ odd ] );
+    MPI_Type_commit( &half_row[ odd ] );
+  }
+}
+
+/* Index in a row of the first double of half_row[ odd ]. */
+int half_row_offset( int cols, int odd )
+{
+  return split? odd * split_half( cols ) : odd;
+}
+
+/**
+ * Update the points of 'color' in rows first..last. With 'check' also
+ * return the largest change, or 'maxdiff' when that is larger.
+ */
+double update_rows( double **grid, int cols, int first, int last, int color, int iter,
+		    int check, double maxdiff )
+{
+  if (color == RED && check)
+    return MAX( maxdiff, compute_grid_red_max( grid, cols, first, last, iter ) );
+  if (color == BLACK && check)
+    return compute_grid_black_max( grid, cols, first, last, iter, maxdiff );
+  if (color == RED)
+    compute_grid_red( grid, cols, first, last, iter );
+  else
+    compute_grid_black( grid, cols, first, last, iter );
+  return maxdiff;
+}
+
+/**
+ * One half-sweep of 'color' over my part of the grid, including the
+ * halo exchange (see update_rows() for 'check' and the return value).
+ *
+ * On a row strip the exchange is hidden behind the interior: the edge
+ * rows 1 and strip_size-2 are updated first, their exchange is started
+ * with MPI_Isend/MPI_Irecv, and the interior rows are updated while the
+ * messages are in flight. MPI_Testall between groups of ROWS_PER_TEST
+ * rows lets MPI progress them, and only then the exchange is waited for.
+ * The interior needs no halo, so the result does not change.
+ *
+ * With deep halos (-d) the strip has 'depth' ghost rows on either side,
+ * rows 1-depth .. 0 and strip_size-1 .. strip_size+depth-2, and they
+ * are exchanged only before every depth-th half-sweep. In between each
+ * half-sweep also updates the ghost rows that still have valid
+ * neighbours, one row fewer on either side each time, which repeats
+ * exactly what the neighbours compute.
+ */
+double half_sweep( double **grid, int cols, int row_len, int strip_size, int rank,
+		   int color, int iter, int check, double maxdiff )
+{
+  MPI_Request requests[4];
+  MPI_Datatype type[ 2 ] = { MPI_DOUBLE, MPI_DOUBLE }; // of the even and the odd local rows
+  int offset[ 2 ] = { 0, 0 };
+  int nrequests = 0, last = strip_size-2, i, flag, count = row_len, size, h0;
+  int first, h;
+  double t;
+
+  if (depth > 1) {
+    h = half_steps++ % depth;
+    if (h == 0)
+      exchange_deep( grid, row_len, strip_size, rank );
+    first = ( rank == 0 )? 1 : 2 - depth + h;
+    last = ( rank == num_nodes-1 )? last : last + depth-1 - h;
+    return update_rows( grid, cols, first, last, color, iter, check, maxdiff );
+  }
+
+  if (blocks) {
+    maxdiff = update_rows( grid, cols, 1, last, color, iter, check, maxdiff );
+    exchange_halo( grid, row_len, strip_size, rank );
+    return maxdiff;
+  }
+
+  maxdiff = update_rows( grid, cols, 1, 1, color, iter, check, maxdiff );
+  if (last > 1)
+    maxdiff = update_rows( grid, cols, last, last, color, iter, check, maxdiff );
+
+  /* With -x only the half-rows of 'color' go: row 1 up and row 'last'
+     down. Local row i has its points of 'color' in the columns of
+     parity (i + parity + color) % 2; the colors go by the global row,
+     so a row is the same half-row on both ranks that hold it. */
+  h0 = (parity + color) % 2;
+  if (color_halo) {
+    type[ 0 ] = half_row[ h0 ];
+    type[ 1 ] = half_row[ 1 - h0 ];
+    offset[ 0 ] = half_row_offset( cols, h0 );
+    offset[ 1 ] = half_row_offset( cols, 1 - h0 );
+    count = 1;
+  }
+
+  t = MPI_Wtime();
+  if (rank != 0) {
+    MPI_Irecv( grid[0] + offset[ 0 ], count, type[ 0 ], rank-1, 0, MPI_COMM_WORLD, &requests[ nrequests++ ] );
+    MPI_Isend( grid[1] + offset[ 1 ], count, type[ 1 ], rank-1, 0, MPI_COMM_WORLD, &requests[ nrequests++ ] );
+    MPI_Type_size( type[ 1 ], &size );
+    halo_bytes += (double) count * size;
+  }
+  if (rank != num_nodes-1) {
+    MPI_Irecv( grid[strip_size-1] + offset[ (last+1) % 2 ], count, type[ (last+1) % 2 ],
+	       rank+1, 0, MPI_COMM_WORLD, &requests[ nrequests++ ] );
+    MPI_Isend( grid[last] + offset[ last % 2 ], count, type[ last % 2 ],
+	       rank+1, 0, MPI_COMM_WORLD, &requests[ nrequests++ ] );
+    MPI_Type_size( type[ last % 2 ], &size );
+    halo_bytes += (double) count * size;
+  }
+  halo_time += MPI_Wtime() - t;
+
+  for (i = 2; i < last; i += ROWS_PER_TEST) {
+    maxdiff = update_rows( grid, cols, i, ( i+ROWS_PER_TEST-1 < last-1 )? i+ROWS_PER_TEST-1 : last-1,
+			   color, iter, check, maxdiff );
+    t = MPI_Wtime();
+    MPI_Testall( nrequests, requests, &flag, MPI_STATUSES_IGNORE );
+    halo_time += MPI_Wtime() - t;
+  }
+
+  t = MPI_Wtime();
+  MPI_Waitall( nrequests, requests, MPI_STATUSES_IGNORE );
+  halo_time += MPI_Wtime() - t;
+  return maxdiff;
+}
+
+/**
+ * Send my first and last 'depth' rows to the neighbours, which keep
+ * them as their ghost rows, in one message each way (-d).
+ */
+void exchange_deep( double **grid, int row_len, int strip_size, int rank )
+{
+  MPI_Request requests[4];
+  int nrequests = 0, last = strip_size-2;
+  double t = MPI_Wtime();
+
+  if (rank != 0) {
+    MPI_Irecv( grid[1-depth], depth * row_len, MPI_DOUBLE, rank-1, 0, MPI_COMM_WORLD, &requests[ nrequests++ ] );
+    MPI_Isend( grid[1], depth * row_len, MPI_DOUBLE, rank-1, 0, MPI_COMM_WORLD, &requests[ nrequests++ ] );
+  }
+  if (rank != num_nodes-1) {
+    MPI_Irecv( grid[last+1], depth * row_len, MPI_DOUBLE, rank+1, 0, MPI_COMM_WORLD, &requests[ nrequests++ ] );
+    MPI_Isend( grid[last+1-depth], depth * row_len, MPI_DOUBLE, rank+1, 0, MPI_COMM_WORLD, &requests[ nrequests++ ] );
+  }
+  MPI_Waitall( nrequests, requests, MPI_STATUSES_IGNORE );
+  halo_bytes += nrequests / 2 * (double) depth * row_len * sizeof(double);
+  halo_time += MPI_Wtime() - t;
+}
+
+/**
+ * Refresh the halo of my part of the grid: the rows above and below a
+ * row strip, or all four sides of a 2-D block (-b). A block sends its
+ * first and last row (without the corners) north and south, and its
+ * first and last column east and west as one 'column_type' each, so a
+ * rank exchanges 2*(rows+cols) doubles instead of two full rows.
+ */
+void exchange_halo( double **grid, int row_len, int strip_size, int rank )
+{
+  MPI_Request requests[8];
+  double t;
+  int size;
+
+  if (!blocks) {
+    exchange_rows( grid, row_len, strip_size, rank );
+    return;
+  }
+
+  t = MPI_Wtime();
+  MPI_Irecv( &grid[0][1], row_len-2, MPI_DOUBLE, north, 0, cart_comm, &requests[0] );
+  MPI_Irecv( &grid[strip_size-1][1], row_len-2, MPI_DOUBLE, south, 0, cart_comm, &requests[1] );
+  MPI_Irecv( &grid[1][0], 1, column_type, west, 0, cart_comm, &requests[2] );
+  MPI_Irecv( &grid[1][row_len-1], 1, column_type, east, 0, cart_comm, &requests[3] );
+  MPI_Isend( &grid[1][1], row_len-2, MPI_DOUBLE, north, 0, cart_comm, &requests[4] );
+  MPI_Isend( &grid[strip_size-2][1], row_len-2, MPI_DOUBLE, south, 0, cart_comm, &requests[5] );
+  MPI_Isend( &grid[1][1], 1, column_type, west, 0, cart_comm, &requests[6] );
+  MPI_Isend( &grid[1][row_len-2], 1, column_type, east, 0, cart_comm, &requests[7] );
+  MPI_Waitall( 8, requests, MPI_STATUSES_IGNORE );
+  MPI_Type_size( column_type, &size );
+  halo_bytes += ( (north != MPI_PROC_NULL) + (south != MPI_PROC_NULL) ) * (row_len-2) * sizeof(double) +
+    ( (west != MPI_PROC_NULL) + (east != MPI_PROC_NULL) ) * (double) size;
+  halo_time += MPI_Wtime() - t;
+}
+
+/**
+ * The reverse of exchange_rows(): add the halo rows to the edge rows of
+ * the neighbours that own them (partial sums of a restriction).
+ */
+void accumulate_rows( double **grid, int gridsize, int strip_size, int rank )
+{
+  MPI_Request request_up;
+  MPI_Request request_down;
+  double *row = (double *) malloc( gridsize * sizeof(double) );
+  double t = MPI_Wtime();
+  int j;
+
+  if (rank != 0) {
+    MPI_Isend( grid[0], gridsize, MPI_DOUBLE, rank-1, 0, MPI_COMM_WORLD, &request_up );
+  }
+  if (rank != num_nodes-1) {
+    MPI_Isend( grid[strip_size-1], gridsize, MPI_DOUBLE, rank+1, 0, MPI_COMM_WORLD, &request_down );
+  }
+  if (rank != 0) {
+    MPI_Recv( row, gridsize, MPI_DOUBLE, rank-1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
+    for (j = 0; j < gridsize; ++j)
+      grid[1][ j ] += row[ j ];
+  }
+  if (rank != num_nodes-1) {
+    MPI_Recv( row, gridsize, MPI_DOUBLE, rank+1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
+    for (j = 0; j < gridsize; ++j)
+      grid[strip_size-2][ j ] += row[ j ];
+  }
+
+  if (rank != 0) {
+    MPI_Wait( &request_up, MPI_STATUS_IGNORE );
+  }
+  if (rank != num_nodes-1) {
+    MPI_Wait( &request_down, MPI_STATUS_IGNORE );
+  }
+  halo_bytes += ( (rank != 0) + (rank != num_nodes-1) ) * gridsize * sizeof(double);
+  halo_time += MPI_Wtime() - t;
+  free( row );
+}
+
+/**
+ * Set up the multigrid levels on the strips, level 0 being 'grid'. The
+ * levels are coarsened while every rank keeps at least MG_STRIP_ROWS
+ * rows; the residual of the last of them is gathered on rank 0, which
+ * has the sequential levels below it.
+ */
+void mg_strip_setup( double **grid, int gridsize, int strip_size, int myrank )
+{
+  strip_level *fine = &levels[ 0 ], *coarse;
+  int p, n, min_rows;
+
+  fine->n = gridsize;
+  fine->first = (int *) malloc( num_nodes * sizeof(int) );
+  fine->count = (int *) malloc( num_nodes * sizeof(int) );
+  for (p = 0; p < num_nodes; ++p) {
+    fine->first[ p ] = p * strip_size + 1;
+    fine->count[ p ] = strip_size;
+  }
+  fine->u = grid;
+  fine->b = NULL;
+  fine->r = mg_allocate( strip_size+2, gridsize+2 );
+  nlevels = 1;
+
+  while (fine->n > MG_COARSEST && nlevels < MG_MAX_LEVELS) {
+    n = mg_coarse_size( fine->n );
+    mg_transfer_init( &fine->up, fine->n, n );
+    coarse = &levels[ nlevels ];
+    coarse->n = n;
+    coarse->first = (int *) malloc( num_nodes * sizeof(int) );
+    coarse->count = (int *) malloc( num_nodes * sizeof(int) );
+    min_rows = n;
+    for (p = 0; p < num_nodes; ++p) {
+      coarse->first[ p ] = fine->up.idx[ fine->first[ p ]-1 ] + 1;
+      coarse->count[ p ] = fine->up.idx[ fine->first[ p ] + fine->count[ p ]-1 ] - coarse->first[ p ] + 1;
+      if (coarse->count[ p ] < min_rows)
+	min_rows = coarse->count[ p ];
+    }
+
+    if (min_rows < MG_STRIP_ROWS || n <= MG_COARSEST) {
+      gather = 1;
+      gather_counts = (int *) malloc( num_nodes * sizeof(int) );
+      gather_displs = (int *) malloc( num_nodes * sizeof(int) );
+      for (p = 0; p < num_nodes; ++p) {
+	gather_counts[ p ] = fine->count[ p ] * (fine->n+2);
+	gather_displs[ p ] = (fine->first[ p ]-1) * (fine->n+2);
+      }
+      if (myrank == 0)
+	ngathered = mg_setup( gathered, mg_allocate( fine->n+2, fine->n+2 ), fine->n );
+      return;
+    }
+
+    coarse->u = mg_allocate( coarse->count[ myrank ]+2, n+2 );
+    coarse->b = mg_allocate( coarse->count[ myrank ]+2, n+2 );
+    coarse->r = mg_allocate( coarse->count[ myrank ]+2, n+2 );
+    fine = coarse;
+    ++nlevels;
+  }
+}
+
+/**
+ * Red or black half-sweep of strip level l, then the halo exchange.
+ */
+void mg_strip_smooth( int l, int myrank, int color )
+{
+  strip_level *level = &levels[ l ];
+  int rows = level->count[ myrank ];
+
+  if (l == 0) {
+    half_sweep( level->u, level->n+2, level->n+2, rows+2, myrank, color, 1, 0, 0.0 );
+    return;
+  }
+  mg_smooth( level->u, level->b, rows, level->n+2, level->first[ myrank ]-1, color );
+  exchange_rows( level->u, level->n+2, rows+2, myrank );
+}
+
+/**
+ * One multigrid cycle (see mg_cycle()) from strip level l.
+ */
+void mg_strip_cycle( int l, int myrank )
+{
+  strip_level *level = &levels[ l ], *coarse = &levels[ l+1 ];
+  int rows = level->count[ myrank ], row0 = level->first[ myrank ]-1;
+  int i, j, k, len;
+
+  if (l == nlevels-1 && !gather) { // only when the grid itself is that small
+    for (k = 0; k < MG_COARSE_SWEEPS; ++k) {
+      mg_strip_smooth( l, myrank, RED );
+      mg_strip_smooth( l, myrank, BLACK );
+    }
+    return;
+  }
+
+  for (k = 0; k < MG_PRE_SWEEPS; ++k) {
+    mg_strip_smooth( l, myrank, RED );
+    mg_strip_smooth( l, myrank, BLACK );
+  }
+  mg_residual( level->r, level->u, level->b, rows, level->n+2 );
+
+  if (l < nlevels-1) {
+    len = (coarse->count[ myrank ]+2) * (coarse->n+2);
+    memset( coarse->b[ 0 ], 0, len * sizeof(double) );
+    mg_restrict( coarse->b, coarse->first[ myrank ]-1, level->r, rows, row0, &level->up );
+    accumulate_rows( coarse->b, coarse->n+2, coarse->count[ myrank ]+2, myrank );
+    memset( coarse->u[ 0 ], 0, len * sizeof(double) );
+    for (k = 0; k < cycle; ++k) {
+      mg_strip_cycle( l+1, myrank );
+    }
+    mg_prolong_add( level->u, rows, row0, coarse->u, coarse->first[ myrank ]-1, &level->up );
+  } else {
+    /* Solve for the correction on rank 0 and add it back. */
+    MPI_Gatherv( level->r[1], rows * (level->n+2), MPI_DOUBLE,
+		 ( myrank == 0 )? gathered[0].r[1] : NULL, gather_counts, gather_displs,
+		 MPI_DOUBLE, 0, MPI_COMM_WORLD );
+    if (myrank == 0) {
+      memset( gathered[0].u[0], 0, (level->n+2) * (level->n+2) * sizeof(double) );
+      mg_correct( gathered, 0, ngathered, cycle );
+    }
+    MPI_Scatterv( ( myrank == 0 )? gathered[0].u[1] : NULL, gather_counts, gather_displs,
+		  MPI_DOUBLE, level->r[1], rows * (level->n+2), MPI_DOUBLE, 0, MPI_COMM_WORLD );
+    for (i = 1; i <= rows; ++i) {
+      for (j = 1; j <= level->n; ++j) {
+	level->u[ i ][ j ] += level->r[ i ][ j ];
+      }
+    }
+  }
+  exchange_rows( level->u, level->n+2, rows+2, myrank );
+
+  for (k = 0; k < MG_POST_SWEEPS; ++k) {
+    mg_strip_smooth( l, myrank, RED );
+    mg_strip_smooth( l, myrank, BLACK );
+  }
 }
 
 void print_grid( double **grid, int myrank,
@@ -223,7 +839,7 @@ void print_grid( double **grid, int myrank,
   for (i = 0; i < strip_size; ++i) {
     printf( "row %d: ", i );
     for (j = 0; j < gridsize; ++j) {
-      printf( "%lf ", grid[ i ][ j ] );
+      printf( "%lf ", split? split_get( grid, i, j, gridsize ) : grid[ i ][ j ] );
     }
     putchar('\n');
   }
@@ -232,18 +848,30 @@ void print_grid( double **grid, int myrank,
 double **init_grid( int gridsize, int strip_size,
 		    int myrank, int num_nodes )
 {
-  int i, j;
+  int i, j, ghost = depth-1; // ghost rows beyond the usual halo row
   double ** outer_ptr;
   double *vals; // to allocate a contiguously array
 
-  vals = (double *) malloc( gridsize * strip_size * sizeof(double) );
-  outer_ptr = (double **) malloc( strip_size * sizeof(double*) );
+  if (split) {
+    outer_ptr = split_allocate_grid( strip_size + 2*ghost, gridsize ) + ghost;
+    for (i = -ghost; i < strip_size + ghost; ++i) {
+      if ((myrank == 0 && i == 0) || (myrank == num_nodes-1 && i == strip_size-1))
+	split_fill_row( outer_ptr[ i ], gridsize, 1.0, 1.0 );
+      else
+	split_fill_row( outer_ptr[ i ], gridsize, 1.0, 0.0 );
+    }
+    return outer_ptr;
+  }
 
-  for (i = 0; i < strip_size; ++i) {
+  vals = (double *) malloc( gridsize * (strip_size + 2*ghost) * sizeof(double) );
+  outer_ptr = (double **) malloc( (strip_size + 2*ghost) * sizeof(double*) );
+
+  for (i = 0; i < strip_size + 2*ghost; ++i) {
     outer_ptr[ i ] = &(vals[i * gridsize]);
   }
+  outer_ptr += ghost; // rows -ghost .. strip_size+ghost-1
 
-  for (i = 0; i < strip_size; ++i) {
+  for (i = -ghost; i < strip_size + ghost; ++i) {
     for (j = 0; j < gridsize; ++j) {
       if (j == 0 || j == (gridsize-1))
 	outer_ptr[ i ][ j ] = 1.0;
@@ -266,3 +894,34 @@ double **init_grid( int gridsize, int strip_size,
 
   return outer_ptr;
 }
+
+/**
+ * Allocate my rows x cols block with its halo, with the boundary values
+ * on the sides that are on the boundary of the grid.
+ */
+double **init_block( int rows, int cols )
+{
+  int i, j;
+  double ** outer_ptr;
+  double *vals; // to allocate a contiguously array
+
+  vals = (double *) calloc( (rows+2) * (cols+2), sizeof(double) );
+  outer_ptr = (double **) malloc( (rows+2) * sizeof(double*) );
+
+  for (i = 0; i < rows+2; ++i) {
+    outer_ptr[ i ] = &(vals[i * (cols+2)]);
+    if (coords[1] == 0)
+      outer_ptr[ i ][ 0 ] = 1.0;
+    if (coords[1] == dims[1]-1)
+      outer_ptr[ i ][ cols+1 ] = 1.0;
+  }
+
+  for (j = 0; j < cols+2; ++j) {
+    if (coords[0] == 0)
+      outer_ptr[ 0 ][ j ] = 1.0;
+    if (coords[0] == dims[0]-1)
+      outer_ptr[ rows+1 ][ j ] = 1.0;
+  }
+
+  return outer_ptr;
+}
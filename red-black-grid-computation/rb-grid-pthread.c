@@ -8,8 +8,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include <pthread.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include "rb-split.h"
+#include "rb-sor.h"
+#include "rb-place.h"
+#include "rb-barrier.h"
 
 int num_iters; // number of iterations
 int gridsize; // the size of the grid
@@ -18,27 +24,24 @@ int num_threads; // number of threads
 int height; // height of the grid for each thread to process
 // maximum difference between old and new values among all the grid cells.
 double * max_diff; 
-volatile int * arrive; // arrive array for the dissemination barrier
+barrier_t *barrier; // barrier of all the threads (rb-barrier.h)
+int barrier_type = BARRIER_DISSEMINATION;
+int split = 0; // store the red and black points apart (rb-split.h)
+int fused = 0; // one pass per iteration, black rows one row behind red
+// last iteration whose red edge rows each thread has computed (fused sweep)
+flags_t *red_done;
+double tolerance = 0.0; // stop once max difference < tolerance (0: run num_iters)
+int check_every = 10; // iterations between two convergence checks
+int iters_done; // iterations done when running with a tolerance
+double omega = 1.0; // SOR factor (rb-sor.h), 0 for the optimal one
+int chebyshev = 0; // change omega every half-sweep (Chebyshev acceleration)
+double *omegas = NULL; // omega of every half-sweep, NULL for Gauss-Seidel
+int interleave = 0; // spread the grid over all NUMA nodes (rb-place.h)
 
 double MAX( double a, double b ) {
   return ( a > b )? a : b;
 }
 
-/*
- * Sychronization barrier for thread 'i'.
- */
-void dissem_barrier( int i )
-{
-  int j, look_at;
-  for (j = 1; j <= ceil( log(num_threads)/log(2) ); ++j) {
-    while (arrive[ i ] != 0) ;
-    arrive[ i ] = j;
-    look_at = ( i + (int)powl(2, j-1) ) % num_threads;
-    while (arrive[ look_at ] != j) ;
-    arrive[ look_at ] = 0;
-  }
-}
-
 /**
  * Allocate a n*n grid
  */
@@ -64,6 +67,14 @@ double ** allocate_grid( int n )
 void init_grid( int first_row, int last_row )
 {
   int i,j;
+
+  if (split) {
+    for (i = first_row; i <= last_row; ++i ) {
+      split_fill_row( grid[i], gridsize+2, 1, ( i == 0 || i == (gridsize+1) )? 1 : 0 );
+    }
+    return;
+  }
+
   /* Initialize grid, including boundaries. */
   for (i = first_row; i <= last_row; ++i ) {
     for (j = 0; j <= (gridsize+1); ++j) {
@@ -78,16 +89,88 @@ void init_grid( int first_row, int last_row )
 }
 
 /*
- * Compute grid for one iteration, given the index of the first row and
- * last row, along with thread id 'id'.
+ * Compute new values for the points of color 'color' in row 'i' in
+ * iteration 'iter'.
  */
-void grid_computation( int first_row, int last_row, int id )
+void update_row( int i, int color, int iter )
+{
+  int jstart, j;
+
+  if (omegas) {
+    sor_update_row( grid, i, gridsize+2, color, omegas[ 2*(iter-1) + color ], split );
+    return;
+  }
+
+  if (split) {
+    split_update_row( grid, i, gridsize+2, color );
+    return;
+  }
+
+  if ((i + color) % 2 == 1) jstart = 1;
+  else jstart = 2;
+
+  for (j = jstart; j <= gridsize; j += 2) {
+    grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
+		       grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
+  }
+}
+
+/*
+ * Compute grid for one iteration in a single pass over the strip: black
+ * row i-1 is computed right after red row i, as it only needs the red
+ * rows i-2..i.
+ *
+ * Across a strip boundary the red and black points of the two edge rows
+ * depend on each other in turn, so one global barrier per iteration is
+ * not enough by itself. The red edge rows are computed first and
+ * published in red_done, the black edge rows last, after the red edge
+ * row of the neighbouring thread is published. The barrier at the end
+ * orders the black edge rows before the red ones of the next iteration.
+ */
+void fused_computation( int first_row, int last_row, int id, int iter )
+{
+  int i;
+
+  update_row( first_row, RED, iter );
+  if (last_row != first_row)
+    update_row( last_row, RED, iter );
+  flags_set( red_done, id, iter );
+
+  for (i = first_row+1; i < last_row; ++i) {
+    update_row( i, RED, iter );
+    if (i-1 > first_row)
+      update_row( i-1, BLACK, iter );
+  }
+  if (last_row-1 > first_row)
+    update_row( last_row-1, BLACK, iter );
+
+  if (id > 0)
+    flags_wait( red_done, id-1, iter );
+  if (id < num_threads-1)
+    flags_wait( red_done, id+1, iter );
+  update_row( first_row, BLACK, iter );
+  if (last_row != first_row)
+    update_row( last_row, BLACK, iter );
+
+  barrier_wait( barrier, id );
+}
+
+/*
+ * Compute grid for iteration 'iter', given the index of the first row
+ * and last row, along with thread id 'id'.
+ */
+void grid_computation( int first_row, int last_row, int id, int iter )
 {
   int jstart, i, j;
   
   /* Compute new values for red points in the grid strip.
      Note that red points only depend on black points. */
   for (i = first_row; i <= last_row; ++i) {
+    if (split || omegas) {
+      update_row( i, RED, iter );
+      continue;
+    }
+
     if (i % 2 == 1) jstart = 1; // odd row
     else jstart = 2; // even row
 
@@ -100,11 +183,16 @@ void grid_computation( int first_row, int last_row, int id )
   /* Insert a barrier. Before computing the value for black points,
      we must make sure that all the red points have been computed because
      the value of black points depend on red points. */
-  dissem_barrier( id );
+  barrier_wait( barrier, id );
     
   /* Compute new values for black points in the grid strip.
      Note that black points only depend on red points. */
   for (i = first_row; i <= last_row; ++i) {
+    if (split || omegas) {
+      update_row( i, BLACK, iter );
+      continue;
+    }
+
     if (i % 2 == 1) jstart = 2; // odd row
     else jstart = 1; // even row
 
@@ -117,40 +205,28 @@ void grid_computation( int first_row, int last_row, int id )
   /* Insert a barrier. Before computing the value for red points,
      we must make sure that all the black points have been computed because
      the value of red points depend on black points. */
-  dissem_barrier( id );
+  barrier_wait( barrier, id );
 }
-/**
- * Thread routine.
- * 'arg' is the index ranging from 0 to num_thread-1 to identify the thread.
+/*
+ * Do iteration 'iter' over the strip and return the max difference
+ * between the old and new values among its grid cells.
  */
-void * worker( void *arg )
+double max_computation( int first_row, int last_row, int id, int iter )
 {
-  int id = *((int *) arg);
-  int first_row = id * height + 1;
-  int last_row = first_row + height - 1;
-  int jstart, iter, i, j;
+  int jstart, i, j;
   double mydiff = 0.0, old;
 
-  if (first_row == 1)
-    init_grid( first_row-1, last_row );
-  else if (last_row == gridsize)
-    init_grid( first_row-1, last_row+1 );
-  else
-    init_grid( first_row, last_row );
-
-  /* Insert a barrier to wait for all the other threads to finish the grid initialization. */
-  dissem_barrier( id );
-
-  for (iter = 1; iter <= num_iters; ++iter) {
-    grid_computation( first_row, last_row, id );
-  }
-
-  /**
-   * Do the iteration one more time to compute the max difference among each cell.
-   */
-
   /* Compute new values for red points in the grid strip. */
   for (i = first_row; i <= last_row; ++i) {
+    if (omegas) {
+      mydiff = sor_update_row_max( grid, i, gridsize+2, RED, omegas[ 2*(iter-1) ], split, mydiff );
+      continue;
+    }
+    if (split) {
+      mydiff = split_update_row_max( grid, i, gridsize+2, RED, mydiff );
+      continue;
+    }
+
     if (i % 2 == 1) jstart = 1; // odd row
     else jstart = 2; // even row
 
@@ -165,10 +241,19 @@ void * worker( void *arg )
   /* Insert a barrier. Before computing the value for black points,
      we must make sure that all the red points have been computed because
      the value of black points depend on red points. */
-  dissem_barrier( id );
+  barrier_wait( barrier, id );
   
   /* Compute new values for black points in the grid strip. */
   for (i = first_row; i <= last_row; ++i) {
+    if (omegas) {
+      mydiff = sor_update_row_max( grid, i, gridsize+2, BLACK, omegas[ 2*(iter-1) + 1 ], split, mydiff );
+      continue;
+    }
+    if (split) {
+      mydiff = split_update_row_max( grid, i, gridsize+2, BLACK, mydiff );
+      continue;
+    }
+
     if (i % 2 == 1) jstart = 2; // odd row
     else jstart = 1; // even row
 
@@ -180,7 +265,59 @@ void * worker( void *arg )
     }
   }
 
-  max_diff[ id ] = mydiff;
+  return mydiff;
+}
+
+/**
+ * Thread routine.
+ * 'arg' is the index ranging from 0 to num_thread-1 to identify the thread.
+ */
+void * worker( void *arg )
+{
+  int id = *((int *) arg);
+  int first_row = id * height + 1;
+  int last_row = first_row + height - 1;
+  int iter, i;
+  double global_diff;
+
+  /* Initialize (and so first touch) my own rows on my CPU, the first and
+     last thread also the boundary rows. */
+  place_pin( id );
+  init_grid( ( first_row == 1 )? 0 : first_row, ( last_row == gridsize )? gridsize+1 : last_row );
+
+  /* Insert a barrier to wait for all the other threads to finish the grid initialization. */
+  barrier_wait( barrier, id );
+
+  for (iter = 1; iter <= num_iters; ++iter) {
+    /* With a tolerance every 'check_every'-th and the last iteration
+       also compute the max difference. All the threads see the same
+       max_diff[] after the barrier and so stop at the same iteration. */
+    if (tolerance > 0.0 && (iter % check_every == 0 || iter == num_iters)) {
+      max_diff[ id ] = max_computation( first_row, last_row, id, iter );
+      barrier_wait( barrier, id );
+      global_diff = 0.0;
+      for (i = 0; i < num_threads; ++i) {
+	global_diff = MAX( global_diff, max_diff[ i ] );
+      }
+      if (global_diff < tolerance)
+	break;
+      continue;
+    }
+
+    if (fused)
+      fused_computation( first_row, last_row, id, iter );
+    else
+      grid_computation( first_row, last_row, id, iter );
+  }
+
+  /**
+   * Do the iteration one more time to compute the max difference among each cell.
+   */
+  if (tolerance == 0.0)
+    max_diff[ id ] = max_computation( first_row, last_row, id, num_iters+1 );
+  else if (id == 0)
+    iters_done = ( iter > num_iters )? num_iters : iter;
+
   return NULL;
 }
 
@@ -189,7 +326,7 @@ void print_grid( double **grid, int size )
   int i, j;
   for (i = 0; i < size; ++i) {
     for (j = 0; j < size; ++j) {
-      printf( "%lf ", grid[i][j] );
+      printf( "%lf ", split? split_get( grid, i, j, size ) : grid[i][j] );
     }
     putchar('\n');
   }
@@ -197,7 +334,7 @@ void print_grid( double **grid, int size )
 
 int main(int argc, char *argv[])
 {
-  int i;
+  int i, opt, row_len;
   int *arg; // argument passed to thread
   double maxdiff = 0.0;
   struct timeval t_start, t_end; // for measuring execution time.
@@ -206,28 +343,84 @@ int main(int argc, char *argv[])
   /**
    * Parse the arguments.
    */
-  if (argc != 4) {
+  while ((opt = getopt( argc, argv, "sfe:k:w:cp:ib:" )) != -1) {
+    switch (opt) {
+    case 's':
+      split = 1;
+      break;
+    case 'f':
+      fused = 1;
+      break;
+    case 'e':
+      tolerance = atof( optarg );
+      break;
+    case 'k':
+      check_every = atoi( optarg );
+      break;
+    case 'w':
+      omega = strcmp( optarg, "auto" )? atof( optarg ) : 0.0;
+      break;
+    case 'c':
+      chebyshev = 1;
+      break;
+    case 'p':
+      if (place_cpus( optarg ) < 0)
+	argc = 0;
+      break;
+    case 'i':
+      interleave = 1;
+      break;
+    case 'b':
+      barrier_type = barrier_kind( optarg );
+      break;
+    default:
+      argc = 0; // print the usage below
+    }
+  }
+
+  if (argc - optind != 3 || tolerance < 0.0 || check_every < 1 ||
+      omega < 0.0 || omega >= 2.0 || barrier_type < 0) {
     printf( "Please pass the right arguments!\n" );
-    printf( "Usage: ./a.out <gridsize> <number of iterations> <number of cores>\n" );
+    printf( "Usage: ./a.out [-s] [-f] [-e tolerance [-k interval]] [-w omega|auto] [-c]\n"
+	    "               [-p cpus] [-i] [-b barrier] <gridsize> <number of iterations> <number of cores>\n" );
+    printf( "  -s  store red and black points in separate halves of each row\n" );
+    printf( "  -f  fused sweep: red row i and black row i-1 in the same pass\n" );
+    printf( "  -e  stop once the max difference is below 'tolerance', checked every\n"
+	    "      'interval' iterations (default %d); the number of iterations is the limit\n", check_every );
+    printf( "  -w  successive over-relaxation with 0 < omega < 2 ('auto': the optimal one)\n" );
+    printf( "  -c  Chebyshev acceleration: change omega every half-sweep\n" );
+    printf( "  -p  pin thread k to the k-th CPU of 'cpus', e.g. 0-7 or 0,2,4,6\n" );
+    printf( "  -i  interleave the grid over all NUMA nodes instead of placing every\n"
+	    "      strip on the node of its thread (needs make NUMA=1)\n" );
+    printf( "  -b  barrier: dissemination (default), tournament or tree\n" );
     return -1;
   }
 
-  gridsize = atoi( argv[1] );
+  gridsize = atoi( argv[optind] );
   if (gridsize % 8 != 0) {
     fprintf( stderr, "grid size %d must be a multiple of 8!\n", gridsize);
     return -1;
   }
-  num_iters = atoi( argv[2] );
-  num_threads = atoi( argv[3] );
+  num_iters = atoi( argv[optind+1] );
+  num_threads = atoi( argv[optind+2] );
+  if (omega == 0.0)
+    omega = sor_optimal_omega( gridsize );
+  if (omega != 1.0 || chebyshev) // one more iteration for the max difference
+    omegas = sor_schedule( 2*num_iters + 2, omega, chebyshev, gridsize );
 
   height = gridsize / num_threads; 
-  grid = allocate_grid( gridsize+2 ); // allocate (gridsize+2) x (gridsize+2) grid
-  max_diff = (double *) malloc( num_threads * sizeof(double) );
-  arrive = (int *) malloc ( num_threads * sizeof(int) );
-
-  for (i = 0; i < num_threads; ++i) {
-    arrive[ i ] = 0;
+  if (split)
+    grid = split_allocate_grid( gridsize+2, gridsize+2 );
+  else
+    grid = allocate_grid( gridsize+2 ); // allocate (gridsize+2) x (gridsize+2) grid
+  row_len = split? split_row_length( gridsize+2 ) : gridsize+2; // doubles per row
+  if (interleave && place_interleave( grid[0], (size_t) (gridsize+2) * row_len * sizeof(double) ) != 0) {
+    fprintf( stderr, "-i needs libnuma and a NUMA kernel (make NUMA=1)\n" );
+    return -1;
   }
+  max_diff = (double *) malloc( num_threads * sizeof(double) );
+  barrier = barrier_create( barrier_type, num_threads );
+  red_done = flags_create( num_threads );
 
   pthread_t threads[num_threads];
   gettimeofday( &t_start, NULL );
@@ -249,8 +442,11 @@ int main(int argc, char *argv[])
     maxdiff = MAX( maxdiff, max_diff[i] );
   }
 
-  printf( "Number of MPI ranks: 0\tNumber of threads: %d\tExecution time:%.3lf sec\tMax difference:%lf\n",
+  printf( "Number of MPI ranks: 0\tNumber of threads: %d\tExecution time:%.3lf sec\tMax difference:%lf",
 	  num_threads, exec_time/1000.0, maxdiff);
+  if (tolerance > 0.0)
+    printf( "\tIterations:%d", iters_done );
+  putchar( '\n' );
 
   return 0;
 }
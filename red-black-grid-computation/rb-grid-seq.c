@@ -1,10 +1,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include "rb-split.h"
+#include "rb-sor.h"
+#include "rb-mg.h"
 
 int num_iters; // number of iterations
 int gridsize; // the size of the grid
+int split = 0; // store the red and black points apart (rb-split.h)
+int depth = 1; // iterations done per pass over the grid (temporal blocking)
+int fused = 0; // one pass per iteration, black rows one row behind red
+double tolerance = 0.0; // stop once max difference < tolerance (0: run num_iters)
+int check_every = 10; // iterations between two convergence checks
+double omega = 1.0; // SOR factor (rb-sor.h), 0 for the optimal one
+int chebyshev = 0; // change omega every half-sweep (Chebyshev acceleration)
+double *omegas = NULL; // omega of every half-sweep, NULL for Gauss-Seidel
+int cycle = 0; // multigrid (rb-mg.h): 1 for V-cycles, 2 for W-cycles
 
 double MAX( double a, double b ) {
   return ( a > b )? a : b;
@@ -44,46 +58,283 @@ void init_grid( double **grid, int size )
   }
 }
 
+/*
+ * Same as init_grid() for a grid in the split layout.
+ */
+void init_split_grid( double **grid, int size )
+{
+  int i;
+  for (i = 0; i < size; ++i) {
+    split_fill_row( grid[i], size, 1, ( i == 0 || i == (size-1) )? 1 : 0 );
+  }
+}
+
+/*
+ * Compute new values for the points of 'color' (RED or BLACK) in row i
+ * in iteration 'iter'.
+ */
+void update_row( double **grid, int i, int color, int iter )
+{
+  int j, jstart;
+
+  if (omegas) {
+    sor_update_row( grid, i, gridsize+2, color, omegas[ 2*(iter-1) + color ], split );
+    return;
+  }
+
+  if (split) {
+    split_update_row( grid, i, gridsize+2, color );
+    return;
+  }
+
+  if ((i + color) % 2 == 1) jstart = 1; // odd row for red, even row for black
+  else jstart = 2;
+
+  for (j = jstart; j <= gridsize; j += 2) {
+    grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
+		       grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
+  }
+}
+
+/*
+ * Half-sweep of 'color' over the whole grid: the smoother of level 0 of
+ * the multigrid cycle (rb-mg.h). 'iter' only picks the SOR factor,
+ * which -m does not allow.
+ */
+void sweep_grid( double **grid, int color )
+{
+  int i;
+
+  for (i = 1; i <= gridsize; ++i) {
+    update_row( grid, i, color, 1 );
+  }
+}
+
+/**
+ * Do 'iters' iterations in a single pass over the grid (temporal
+ * blocking with a wavefront over the rows).
+ *
+ * Half-step h of the block (red for even h, black for odd h) is applied
+ * to row r-h while the front r moves down the grid. When row x gets
+ * half-step h, rows x-1 and x got half-step h-1 at an earlier front and
+ * row x+1 earlier at this front, and none of them is past half-step h
+ * yet, so every point sees exactly the values of the plain red sweep /
+ * black sweep order and the result is the same. Only the 2*iters+1
+ * rows behind the front are touched, so they stay in cache and the
+ * grid is streamed from memory once per block instead of 2*iters times.
+ */
+void wavefront( double **grid, int first_row, int last_row, int first_iter, int iters )
+{
+  int r, h, x;
+
+  for (r = first_row; r <= last_row + 2*iters - 1; ++r) {
+    for (h = 0; h < 2*iters; ++h) {
+      x = r - h;
+      if (x >= first_row && x <= last_row)
+	update_row( grid, x, h % 2, first_iter + h / 2 );
+    }
+  }
+}
+
 void print_grid( double **grid, int size )
 {
   int i, j;
   for (i = 0; i < size; ++i) {
     for (j = 0; j < size; ++j) {
-      printf( "%lf ", grid[i][j] );
+      printf( "%lf ", split? split_get( grid, i, j, size ) : grid[i][j] );
     }
     putchar('\n');
   }
 }
 
+/*
+ * Do iteration 'iter' over rows first_row..last_row and return the max
+ * difference between the old and new values among all the grid cells.
+ */
+double max_sweep( double **grid, int first_row, int last_row, int iter )
+{
+  double max_diff = 0.0, old;
+  int jstart, i, j;
+
+  if (omegas) {
+    for (i = first_row; i <= last_row; ++i) {
+      max_diff = sor_update_row_max( grid, i, gridsize+2, RED, omegas[ 2*(iter-1) ], split, max_diff );
+    }
+    for (i = first_row; i <= last_row; ++i) {
+      max_diff = sor_update_row_max( grid, i, gridsize+2, BLACK, omegas[ 2*(iter-1) + 1 ], split, max_diff );
+    }
+    return max_diff;
+  }
+
+  if (split) {
+    for (i = first_row; i <= last_row; ++i) {
+      max_diff = split_update_row_max( grid, i, gridsize+2, RED, max_diff );
+    }
+    for (i = first_row; i <= last_row; ++i) {
+      max_diff = split_update_row_max( grid, i, gridsize+2, BLACK, max_diff );
+    }
+    return max_diff;
+  }
+
+  /* Compute new values for red points in the grid. */
+  for (i = first_row; i <= last_row; ++i) {
+    if (i % 2 == 1) jstart = 1; // odd row
+    else jstart = 2; // even row
+
+    for (j = jstart; j <= gridsize; j += 2) {
+      old = grid[ i ][ j ];
+      grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
+			 grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
+      max_diff = MAX( max_diff, fabs(old - grid[i][j]) );
+    }
+  }
+
+  /* Compute new values for black points in the grid. */
+  for (i = first_row; i <= last_row; ++i) {
+    if (i % 2 == 1) jstart = 2; // odd row
+    else jstart = 1; // even row
+
+    for (j = jstart; j <= gridsize; j += 2) {
+      old = grid[ i ][ j ];
+      grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
+			 grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
+      max_diff = MAX( max_diff, fabs(old - grid[i][j]) );
+    }
+  }
+
+  return max_diff;
+}
+
 int main(int argc, char *argv[])
 {
   double ** grid;
-  double max_diff = 0.0, old;
-  int first_row, last_row;
-  int iter, jstart, i, j;
+  double max_diff = 0.0;
+  int first_row, last_row, last, nlevels;
+  mg_level levels[ MG_MAX_LEVELS ];
+  int iter, jstart, i, j, opt;
   struct timeval t_start, t_end; // for measuring execution time.
   double exec_time;
 
   /**
    * Parse the arguments.
    */
-  if (argc != 3) {
+  while ((opt = getopt( argc, argv, "sft:e:k:w:cm:" )) != -1) {
+    switch (opt) {
+    case 's':
+      split = 1;
+      break;
+    case 'f':
+      fused = 1;
+      break;
+    case 't':
+      depth = atoi( optarg );
+      break;
+    case 'e':
+      tolerance = atof( optarg );
+      break;
+    case 'k':
+      check_every = atoi( optarg );
+      break;
+    case 'w':
+      omega = strcmp( optarg, "auto" )? atof( optarg ) : 0.0;
+      break;
+    case 'c':
+      chebyshev = 1;
+      break;
+    case 'm':
+      cycle = ( optarg[0] == 'W' || optarg[0] == 'w' )? 2 : 1;
+      break;
+    default:
+      argc = 0; // print the usage below
+    }
+  }
+
+  if (argc - optind != 2 || depth < 1 || tolerance < 0.0 || check_every < 1 ||
+      omega < 0.0 || omega >= 2.0 ||
+      (cycle && (split || depth > 1 || fused || omega != 1.0 || chebyshev))) {
     printf( "Please pass the right arguments!\n" );
-    printf( "Usage: ./a.out <gridsize> <number of iterations>\n" );
+    printf( "Usage: ./a.out [-s] [-f] [-t depth] [-e tolerance [-k interval]] [-w omega|auto] [-c] [-m V|W]\n"
+	    "               <gridsize> <number of iterations>\n" );
+    printf( "  -s  store red and black points in separate halves of each row\n" );
+    printf( "  -f  fused sweep: red row i and black row i-1 in the same pass\n" );
+    printf( "  -t  do 'depth' iterations per pass over the grid (wavefront)\n" );
+    printf( "  -e  stop once the max difference is below 'tolerance', checked every\n"
+	    "      'interval' iterations (default %d); the number of iterations is the limit.\n"
+	    "      With -m the check is an extra red/black sweep after the cycle\n", check_every );
+    printf( "  -w  successive over-relaxation with 0 < omega < 2 ('auto': the optimal one)\n" );
+    printf( "  -c  Chebyshev acceleration: change omega every half-sweep\n" );
+    printf( "  -m  one multigrid V- or W-cycle per iteration (not with -s, -f, -t, -w, -c)\n" );
     return -1;
   }
 
-  gridsize = atoi( argv[1] );
-  num_iters = atoi( argv[2] );
+  gridsize = atoi( argv[optind] );
+  num_iters = atoi( argv[optind+1] );
+  if (omega == 0.0)
+    omega = sor_optimal_omega( gridsize );
+  if (omega != 1.0 || chebyshev) // one more iteration for the max difference
+    omegas = sor_schedule( 2*num_iters + 2, omega, chebyshev, gridsize );
 
-  grid = allocate_grid( gridsize+2 );
-  gettimeofday( &t_start, NULL );
-  init_grid( grid, gridsize+2 );
+  if (split) {
+    grid = split_allocate_grid( gridsize+2, gridsize+2 );
+    gettimeofday( &t_start, NULL );
+    init_split_grid( grid, gridsize+2 );
+  } else {
+    grid = allocate_grid( gridsize+2 );
+    if (cycle) {
+      nlevels = mg_setup( levels, grid, gridsize );
+      levels[ 0 ].sweep = sweep_grid;
+    }
+    gettimeofday( &t_start, NULL );
+    init_grid( grid, gridsize+2 );
+  }
 
   first_row = 1;
   last_row = gridsize;
 
   for (iter = 1; iter <= num_iters; ++iter) {
+    if (cycle) {
+      mg_cycle( levels, 0, nlevels, cycle );
+      if (tolerance > 0.0 && (iter % check_every == 0 || iter == num_iters)) {
+	max_diff = max_sweep( grid, first_row, last_row, iter );
+	if (max_diff < tolerance)
+	  break;
+      }
+      continue;
+    }
+
+    /* With a tolerance every 'check_every'-th and the last iteration
+       also compute the max difference. */
+    if (tolerance > 0.0) {
+      if (iter % check_every == 0 || iter == num_iters) {
+	max_diff = max_sweep( grid, first_row, last_row, iter );
+	if (max_diff < tolerance)
+	  break;
+	continue;
+      }
+      last = ( iter / check_every + 1 ) * check_every - 1; // last one before the check
+      if (last > num_iters - 1)
+	last = num_iters - 1;
+    } else {
+      last = num_iters;
+    }
+
+    if (depth > 1 || fused) { // fused is the wavefront one iteration deep
+      int iters = ( last - iter + 1 < depth )? last - iter + 1 : depth;
+      wavefront( grid, first_row, last_row, iter, iters );
+      iter += iters - 1;
+      continue;
+    }
+
+    if (split || omegas) {
+      for (i = first_row; i <= last_row; ++i) {
+	update_row( grid, i, RED, iter );
+      }
+      for (i = first_row; i <= last_row; ++i) {
+	update_row( grid, i, BLACK, iter );
+      }
+      continue;
+    }
+
     /* Compute new values for red points in the grid. */
     for (i = first_row; i <= last_row; ++i) {
       if (i % 2 == 1) jstart = 1; // odd row
@@ -110,39 +361,18 @@ int main(int argc, char *argv[])
   /**
    * Do the iteration one more time to compute the max difference among each cell.
    */
-
-  /* Compute new values for red points in the grid. */
-  for (i = first_row; i <= last_row; ++i) {
-    if (i % 2 == 1) jstart = 1; // odd row
-    else jstart = 2; // even row
-
-    for (j = jstart; j <= gridsize; j += 2) {
-      old = grid[ i ][ j ];
-      grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
-			 grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
-      max_diff = MAX( max_diff, fabs(old - grid[i][j]) );
-    }
-  }
-
-  /* Compute new values for black points in the grid. */
-  for (i = first_row; i <= last_row; ++i) {
-    if (i % 2 == 1) jstart = 2; // odd row
-    else jstart = 1; // even row
-
-    for (j = jstart; j <= gridsize; j += 2) {
-      old = grid[ i ][ j ];
-      grid[ i ][ j ] = ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
-			 grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25;
-      max_diff = MAX( max_diff, fabs(old - grid[i][j]) );
-    }
-  }
+  if (tolerance == 0.0)
+    max_diff = max_sweep( grid, first_row, last_row, num_iters+1 );
 
   gettimeofday( &t_end, NULL );
   exec_time = (t_end.tv_sec - t_start.tv_sec) * 1000.0; // sec to ms
   exec_time += (t_end.tv_usec - t_start.tv_usec) / 1000.0; // us to ms
   
-  printf( "Number of MPI ranks: 0\tNumber of threads: 1\tExecution time:%.3lf sec\tMax difference:%lf\n",
+  printf( "Number of MPI ranks: 0\tNumber of threads: 1\tExecution time:%.3lf sec\tMax difference:%lf",
 	  exec_time/1000.0, max_diff);
+  if (tolerance > 0.0)
+    printf( "\tIterations:%d", ( iter > num_iters )? num_iters : iter );
+  putchar( '\n' );
 
   return 0;
 }
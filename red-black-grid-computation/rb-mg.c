@@ -0,0 +1,194 @@
+/**
+ * Geometric multigrid for the red/black grid (see rb-mg.h).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rb-split.h"
+#include "rb-mg.h"
+
+double **mg_allocate( int rows, int cols )
+{
+  int i;
+  double ** outer_ptr;
+  double *vals; // to allocate a contiguously array
+
+  vals = (double *) calloc( (size_t) rows * cols, sizeof(double) );
+  outer_ptr = (double **) malloc( rows * sizeof(double*) );
+
+  for (i = 0; i < rows; ++i) {
+    outer_ptr[ i ] = &(vals[(size_t) i * cols]);
+  }
+
+  return outer_ptr;
+}
+
+int mg_coarse_size( int n )
+{
+  return n / 2;
+}
+
+void mg_transfer_init( mg_transfer *t, int nf, int nc )
+{
+  int i;
+  double x;
+
+  t->nf = nf;
+  t->nc = nc;
+  t->idx = (int *) malloc( (nf+2) * sizeof(int) );
+  t->wt = (double *) malloc( (nf+2) * sizeof(double) );
+  for (i = 0; i <= nf+1; ++i) {
+    x = (double) i * (nc+1) / (nf+1); // position in coarse spacings
+    t->idx[ i ] = (int) floor( x );
+    t->wt[ i ] = x - t->idx[ i ];
+  }
+}
+
+int mg_setup( mg_level *levels, double **grid, int n )
+{
+  int l = 0;
+
+  levels[ 0 ].n = n;
+  levels[ 0 ].u = grid;
+  levels[ 0 ].b = NULL;
+  levels[ 0 ].r = mg_allocate( n+2, n+2 );
+  levels[ 0 ].sweep = NULL;
+
+  while (levels[ l ].n > MG_COARSEST && l+1 < MG_MAX_LEVELS) {
+    n = mg_coarse_size( levels[ l ].n );
+    mg_transfer_init( &levels[ l ].up, levels[ l ].n, n );
+    ++l;
+    levels[ l ].n = n;
+    levels[ l ].u = mg_allocate( n+2, n+2 );
+    levels[ l ].b = mg_allocate( n+2, n+2 );
+    levels[ l ].r = mg_allocate( n+2, n+2 );
+    levels[ l ].sweep = NULL;
+  }
+
+  return l+1;
+}
+
+void mg_smooth( double **u, double **b, int rows, int cols, int row0, int color )
+{
+  int i, j, jstart;
+
+  for (i = 1; i <= rows; ++i) {
+    if ((row0 + i + color) % 2 == 1) jstart = 1; // odd row for red, even row for black
+    else jstart = 2;
+
+    if (b == NULL) {
+      for (j = jstart; j < cols-1; j += 2) {
+	u[ i ][ j ] = ( u[ i-1 ][ j ] + u[ i+1 ][ j ] +
+			u[ i ][ j-1 ] + u[ i ][ j+1 ] ) * 0.25;
+      }
+    } else {
+      for (j = jstart; j < cols-1; j += 2) {
+	u[ i ][ j ] = ( u[ i-1 ][ j ] + u[ i+1 ][ j ] +
+			u[ i ][ j-1 ] + u[ i ][ j+1 ] + b[ i ][ j ] ) * 0.25;
+      }
+    }
+  }
+}
+
+void mg_residual( double **r, double **u, double **b, int rows, int cols )
+{
+  int i, j;
+
+  for (i = 1; i <= rows; ++i) {
+    for (j = 1; j < cols-1; ++j) {
+      r[ i ][ j ] = ( b? b[ i ][ j ] : 0.0 ) - 4.0 * u[ i ][ j ] +
+	u[ i-1 ][ j ] + u[ i+1 ][ j ] + u[ i ][ j-1 ] + u[ i ][ j+1 ];
+    }
+  }
+}
+
+void mg_restrict( double **b, int crow0, double **r, int rows, int row0, const mg_transfer *t )
+{
+  int i, j, I, J;
+  double *row = (double *) malloc( (t->nc+2) * sizeof(double) );
+
+  for (i = 1; i <= rows; ++i) {
+    /* P^T along the row, then add the row to the two coarse rows. */
+    memset( row, 0, (t->nc+2) * sizeof(double) );
+    for (j = 1; j <= t->nf; ++j) {
+      J = t->idx[ j ];
+      row[ J ] += (1.0 - t->wt[ j ]) * r[ i ][ j ];
+      row[ J+1 ] += t->wt[ j ] * r[ i ][ j ];
+    }
+    I = t->idx[ row0 + i ] - crow0;
+    for (J = 1; J <= t->nc; ++J) {
+      b[ I ][ J ] += (1.0 - t->wt[ row0 + i ]) * row[ J ];
+      b[ I+1 ][ J ] += t->wt[ row0 + i ] * row[ J ];
+    }
+  }
+
+  free( row );
+}
+
+void mg_prolong_add( double **u, int rows, int row0, double **e, int crow0, const mg_transfer *t )
+{
+  int i, j, J;
+  double wi, wj;
+  const double *e0, *e1;
+
+  for (i = 1; i <= rows; ++i) {
+    e0 = e[ t->idx[ row0 + i ] - crow0 ];
+    e1 = e[ t->idx[ row0 + i ] - crow0 + 1 ];
+    wi = t->wt[ row0 + i ];
+    for (j = 1; j <= t->nf; ++j) {
+      J = t->idx[ j ];
+      wj = t->wt[ j ];
+      u[ i ][ j ] += (1.0 - wi) * ( (1.0 - wj) * e0[ J ] + wj * e0[ J+1 ] ) +
+	wi * ( (1.0 - wj) * e1[ J ] + wj * e1[ J+1 ] );
+    }
+  }
+}
+
+void mg_correct( mg_level *levels, int l, int nlevels, int gamma )
+{
+  mg_level *fine = &levels[ l ], *coarse = &levels[ l+1 ];
+  size_t len = (size_t) (coarse->n+2) * (coarse->n+2) * sizeof(double);
+  int k;
+
+  memset( coarse->b[ 0 ], 0, len );
+  mg_restrict( coarse->b, 0, fine->r, fine->n, 0, &fine->up );
+  memset( coarse->u[ 0 ], 0, len );
+  for (k = 0; k < gamma; ++k) {
+    mg_cycle( levels, l+1, nlevels, gamma );
+  }
+  mg_prolong_add( fine->u, fine->n, 0, coarse->u, 0, &fine->up );
+}
+
+/*
+ * 'sweeps' red/black sweeps of one level.
+ */
+static void smooth_level( mg_level *level, int sweeps )
+{
+  int k, n = level->n;
+
+  for (k = 0; k < sweeps; ++k) {
+    if (level->sweep) {
+      level->sweep( level->u, RED );
+      level->sweep( level->u, BLACK );
+    } else {
+      mg_smooth( level->u, level->b, n, n+2, 0, RED );
+      mg_smooth( level->u, level->b, n, n+2, 0, BLACK );
+    }
+  }
+}
+
+void mg_cycle( mg_level *levels, int l, int nlevels, int gamma )
+{
+  mg_level *level = &levels[ l ];
+  int n = level->n;
+
+  if (l == nlevels-1) {
+    smooth_level( level, MG_COARSE_SWEEPS );
+    return;
+  }
+
+  smooth_level( level, MG_PRE_SWEEPS );
+  mg_residual( level->r, level->u, level->b, n, n+2 );
+  mg_correct( levels, l, nlevels, gamma );
+  smooth_level( level, MG_POST_SWEEPS );
+}
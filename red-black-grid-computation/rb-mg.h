@@ -0,0 +1,110 @@
+/**
+ * Geometric multigrid with the red/black Gauss-Seidel sweep as the
+ * smoother.
+ *
+ * Level 0 is the grid of the drivers: n*n interior points with the
+ * boundary values in rows and columns 0 and n+1. Level l+1 has
+ * n_l / 2 interior points per side on the same square, so its spacing
+ * is (n_l+1) / (n_l/2+1) fine spacings: exactly 2 when n_l is odd
+ * (every coarse point is a fine point), a little less when n_l is even.
+ * Corrections go down by 1-D linear interpolation P in each direction
+ * and residuals go up by its transpose.
+ *
+ * Every level l > 0 holds the correction e of the level above, with
+ * zero boundary values, for
+ *
+ *   4 e(i,j) - e(i-1,j) - e(i+1,j) - e(i,j-1) - e(i,j+1) = b(i,j)
+ *
+ * with b = P^T r (this already carries the ratio of the squared mesh
+ * widths). Level 0 has b = 0, so it is smoothed with the driver's own
+ * red/black half-sweep when the driver sets mg_level.sweep, and with
+ * mg_smooth() otherwise.
+ *
+ * The kernels work on any block of 'rows' interior rows, with one halo
+ * row above and below and 'row0' the global index of local row 0, so
+ * the MPI driver uses them on its row strips as well.
+ */
+#ifndef RB_MG_H
+#define RB_MG_H
+
+#define MG_MAX_LEVELS 32
+#define MG_PRE_SWEEPS 2 // smoothing sweeps before the coarse correction
+#define MG_POST_SWEEPS 2 // and after
+#define MG_COARSEST 2 // levels this small are solved by sweeping only
+#define MG_COARSE_SWEEPS 20
+
+/**
+ * Interpolation from a grid of nc to one of nf interior points per
+ * side: fine index i (0..nf+1) lies between coarse indices idx[i] and
+ * idx[i]+1, with weight wt[i] on the latter.
+ */
+typedef struct {
+  int nf, nc;
+  int *idx;
+  double *wt;
+} mg_transfer;
+
+typedef struct {
+  int n; // interior points per side
+  double **u; // the grid (level 0) or the correction
+  double **b; // right-hand side, NULL for zero
+  double **r; // residual
+  mg_transfer up; // interpolation from this level to the one above
+  void (*sweep)( double **u, int color ); // half-sweep of u, NULL for mg_smooth()
+} mg_level;
+
+/**
+ * Allocate a zeroed rows x cols grid, contiguously.
+ */
+double **mg_allocate( int rows, int cols );
+
+/* Interior points per side of the level below one of n. */
+int mg_coarse_size( int n );
+
+/* Set up the interpolation from nc to nf points per side. */
+void mg_transfer_init( mg_transfer *t, int nf, int nc );
+
+/**
+ * Set up the levels below 'grid' (level 0, n*n interior points) and
+ * return their number. Every level starts with sweep NULL.
+ */
+int mg_setup( mg_level *levels, double **grid, int n );
+
+/**
+ * One red or black half-sweep over rows 1..rows, with b NULL for zero.
+ * A point is red when its global row + column is even.
+ */
+void mg_smooth( double **u, double **b, int rows, int cols, int row0, int color );
+
+/**
+ * r <- b - (4u - sum of the four neighbours) in rows 1..rows.
+ */
+void mg_residual( double **r, double **u, double **b, int rows, int cols );
+
+/**
+ * Add P^T r of the fine rows 1..rows to the coarse grid b, whose local
+ * row 0 is global coarse row 'crow0'. The coarse rows touched are those
+ * of the fine rows, plus at most one more on either side.
+ */
+void mg_restrict( double **b, int crow0, double **r, int rows, int row0, const mg_transfer *t );
+
+/**
+ * u <- u + P e in the fine rows 1..rows. The coarse rows needed are
+ * those of the fine rows plus one on either side.
+ */
+void mg_prolong_add( double **u, int rows, int row0, double **e, int crow0, const mg_transfer *t );
+
+/**
+ * Coarse-grid correction of level l: restrict its residual, do 'gamma'
+ * cycles on level l+1 from a zero guess and add the interpolated
+ * correction to level l.
+ */
+void mg_correct( mg_level *levels, int l, int nlevels, int gamma );
+
+/**
+ * One cycle from level l: a V-cycle for gamma = 1, a W-cycle for
+ * gamma = 2.
+ */
+void mg_cycle( mg_level *levels, int l, int nlevels, int gamma );
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * Red/black SOR (see rb-sor.h).
+ */
+#include <stdlib.h>
+#include <math.h>
+#include "rb-split.h"
+#include "rb-sor.h"
+
+double sor_jacobi_radius( int n )
+{
+  return cos( M_PI / (n + 1) );
+}
+
+double sor_optimal_omega( int n )
+{
+  double rho = sor_jacobi_radius( n );
+
+  return 2.0 / (1.0 + sqrt( 1.0 - rho * rho ));
+}
+
+double *sor_schedule( int half_sweeps, double omega, int chebyshev, int n )
+{
+  double *w = (double *) malloc( half_sweeps * sizeof(double) );
+  double rho = sor_jacobi_radius( n );
+  int k;
+
+  for (k = 0; k < half_sweeps; ++k) {
+    if (!chebyshev)
+      w[ k ] = omega;
+    else if (k == 0)
+      w[ k ] = 1.0;
+    else if (k == 1)
+      w[ k ] = 1.0 / (1.0 - rho * rho / 2.0);
+    else
+      w[ k ] = 1.0 / (1.0 - rho * rho * w[ k-1 ] / 4.0);
+  }
+  return w;
+}
+
+void sor_update_row( double **grid, int i, int cols, int color, double omega, int split )
+{
+  int j, jstart;
+
+  if (split) {
+    split_sor_update_row( grid, i, cols, color, omega );
+    return;
+  }
+
+  if ((i + color) % 2 != 0) jstart = 1; // odd row for red, even row for black
+  else jstart = 2;
+
+  for (j = jstart; j < cols-1; j += 2) {
+    grid[ i ][ j ] += omega * ( ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
+				  grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25 - grid[ i ][ j ] );
+  }
+}
+
+double sor_update_row_max( double **grid, int i, int cols, int color, double omega, int split,
+			   double maxdiff )
+{
+  int j, jstart;
+  double d;
+
+  if (split)
+    return split_sor_update_row_max( grid, i, cols, color, omega, maxdiff );
+
+  if ((i + color) % 2 != 0) jstart = 1;
+  else jstart = 2;
+
+  for (j = jstart; j < cols-1; j += 2) {
+    d = omega * ( ( grid[ i-1 ][ j ] + grid[ i+1 ][ j ] +
+		    grid[ i ][ j-1 ] + grid[ i ][ j+1 ] ) * 0.25 - grid[ i ][ j ] );
+    grid[ i ][ j ] += d;
+    d = fabs( d );
+    maxdiff = ( d > maxdiff )? d : maxdiff;
+  }
+  return maxdiff;
+}
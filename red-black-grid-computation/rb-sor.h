@@ -0,0 +1,51 @@
+/**
+ * Red/black successive over-relaxation (SOR).
+ *
+ * A SOR half-sweep moves every point of one color from its old value
+ * past the Gauss-Seidel average by the factor omega:
+ *
+ *   new = old + omega * (average - old)
+ *
+ * omega = 1 is the plain Gauss-Seidel update the drivers do by default.
+ * They keep their own code for that case, so its results do not change.
+ * For 1 < omega < 2 the error decays much faster; the best fixed value
+ * for the n*n Laplace problem is
+ *
+ *   omega = 2 / (1 + sqrt(1 - rho^2)),  rho = cos(pi / (n+1))
+ *
+ * where rho is the spectral radius of the Jacobi iteration. With
+ * Chebyshev acceleration omega changes every half-sweep instead
+ * (Numerical Recipes 19.5): 1 for the first red sweep, 1 / (1 - rho^2/2)
+ * for the first black sweep and 1 / (1 - rho^2 omega / 4) after that,
+ * which tends to the same optimal value but cuts the error from the
+ * first iterations on.
+ */
+#ifndef RB_SOR_H
+#define RB_SOR_H
+
+/* Spectral radius of the Jacobi iteration on an n*n grid. */
+double sor_jacobi_radius( int n );
+
+/* Best fixed omega for an n*n grid. */
+double sor_optimal_omega( int n );
+
+/**
+ * Allocate the omega of 'half_sweeps' half-sweeps: element 2*(k-1) is
+ * used by the red and 2*(k-1)+1 by the black sweep of iteration k.
+ * Every element is 'omega', or the Chebyshev sequence for an n*n grid
+ * when 'chebyshev' is set.
+ */
+double *sor_schedule( int half_sweeps, double omega, int chebyshev, int n );
+
+/**
+ * Update the points of 'color' (RED or BLACK) in columns 1..cols-2 of
+ * row i with the factor omega, in the interleaved layout or, when
+ * 'split' is set, in the split layout (see rb-split.h). The _max
+ * variant also returns the largest change, or 'maxdiff' when that is
+ * larger.
+ */
+void sor_update_row( double **grid, int i, int cols, int color, double omega, int split );
+double sor_update_row_max( double **grid, int i, int cols, int color, double omega, int split,
+			   double maxdiff );
+
+#endif
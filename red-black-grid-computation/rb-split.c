@@ -0,0 +1,164 @@
+/**
+ * Row kernels for the split red/black layout (see rb-split.h).
+ */
+#include <stdlib.h>
+#include <math.h>
+#include "rb-split.h"
+
+int split_half( int cols )
+{
+  return (cols + 1) / 2;
+}
+
+int split_row_length( int cols )
+{
+  return 2 * split_half( cols );
+}
+
+double **split_allocate_grid( int rows, int cols )
+{
+  int i, len = split_row_length( cols );
+  double ** outer_ptr;
+  double *vals; // to allocate a contiguously array
+
+  vals = (double *) malloc( (size_t) rows * len * sizeof(double) );
+  outer_ptr = (double **) malloc( rows * sizeof(double*) );
+
+  for (i = 0; i < rows; ++i) {
+    outer_ptr[ i ] = &(vals[(size_t) i * len]);
+  }
+
+  return outer_ptr;
+}
+
+void split_fill_row( double *row, int cols, double edge, double inner )
+{
+  int h = split_half( cols ), j;
+
+  for (j = 0; j < cols; ++j) {
+    row[ (j % 2) * h + j / 2 ] = ( j == 0 || j == cols-1 )? edge : inner;
+  }
+}
+
+double split_get( double **grid, int i, int j, int cols )
+{
+  return grid[ i ][ (j % 2) * split_half( cols ) + j / 2 ];
+}
+
+/*
+ * Red points have i+j even: odd columns of odd rows and even columns of
+ * even rows. Black points are the other way round.
+ */
+static int odd_columns( int i, int color )
+{
+  return (i + color) % 2;
+}
+
+void split_update_row( double **grid, int i, int cols, int color )
+{
+  int h = split_half( cols ), k, kend;
+
+  if (odd_columns( i, color )) { // j = 2k+1, left 2k and right 2k+2 are even
+    double *restrict c = grid[ i ] + h;
+    const double *up = grid[ i-1 ] + h, *down = grid[ i+1 ] + h, *even = grid[ i ];
+    kend = (cols - 3) / 2;
+#pragma omp simd
+    for (k = 0; k <= kend; ++k) {
+      c[ k ] = ( up[ k ] + down[ k ] + even[ k ] + even[ k+1 ] ) * 0.25;
+    }
+  } else { // j = 2k, left 2k-1 and right 2k+1 are odd
+    double *restrict c = grid[ i ];
+    const double *up = grid[ i-1 ], *down = grid[ i+1 ], *odd = grid[ i ] + h;
+    kend = (cols - 2) / 2;
+#pragma omp simd
+    for (k = 1; k <= kend; ++k) {
+      c[ k ] = ( up[ k ] + down[ k ] + odd[ k-1 ] + odd[ k ] ) * 0.25;
+    }
+  }
+}
+
+double split_update_row_max( double **grid, int i, int cols, int color, double maxdiff )
+{
+  int h = split_half( cols ), k, kend;
+  double v, d;
+
+  if (odd_columns( i, color )) {
+    double *restrict c = grid[ i ] + h;
+    const double *up = grid[ i-1 ] + h, *down = grid[ i+1 ] + h, *even = grid[ i ];
+    kend = (cols - 3) / 2;
+#pragma omp simd private(v, d) reduction(max:maxdiff)
+    for (k = 0; k <= kend; ++k) {
+      v = ( up[ k ] + down[ k ] + even[ k ] + even[ k+1 ] ) * 0.25;
+      d = fabs( c[ k ] - v );
+      maxdiff = ( d > maxdiff )? d : maxdiff;
+      c[ k ] = v;
+    }
+  } else {
+    double *restrict c = grid[ i ];
+    const double *up = grid[ i-1 ], *down = grid[ i+1 ], *odd = grid[ i ] + h;
+    kend = (cols - 2) / 2;
+#pragma omp simd private(v, d) reduction(max:maxdiff)
+    for (k = 1; k <= kend; ++k) {
+      v = ( up[ k ] + down[ k ] + odd[ k-1 ] + odd[ k ] ) * 0.25;
+      d = fabs( c[ k ] - v );
+      maxdiff = ( d > maxdiff )? d : maxdiff;
+      c[ k ] = v;
+    }
+  }
+  return maxdiff;
+}
+
+void split_sor_update_row( double **grid, int i, int cols, int color, double omega )
+{
+  int h = split_half( cols ), k, kend;
+
+  if (odd_columns( i, color )) {
+    double *restrict c = grid[ i ] + h;
+    const double *up = grid[ i-1 ] + h, *down = grid[ i+1 ] + h, *even = grid[ i ];
+    kend = (cols - 3) / 2;
+#pragma omp simd
+    for (k = 0; k <= kend; ++k) {
+      c[ k ] += omega * ( ( up[ k ] + down[ k ] + even[ k ] + even[ k+1 ] ) * 0.25 - c[ k ] );
+    }
+  } else {
+    double *restrict c = grid[ i ];
+    const double *up = grid[ i-1 ], *down = grid[ i+1 ], *odd = grid[ i ] + h;
+    kend = (cols - 2) / 2;
+#pragma omp simd
+    for (k = 1; k <= kend; ++k) {
+      c[ k ] += omega * ( ( up[ k ] + down[ k ] + odd[ k-1 ] + odd[ k ] ) * 0.25 - c[ k ] );
+    }
+  }
+}
+
+double split_sor_update_row_max( double **grid, int i, int cols, int color, double omega,
+				 double maxdiff )
+{
+  int h = split_half( cols ), k, kend;
+  double d;
+
+  if (odd_columns( i, color )) {
+    double *restrict c = grid[ i ] + h;
+    const double *up = grid[ i-1 ] + h, *down = grid[ i+1 ] + h, *even = grid[ i ];
+    kend = (cols - 3) / 2;
+#pragma omp simd private(d) reduction(max:maxdiff)
+    for (k = 0; k <= kend; ++k) {
+      d = omega * ( ( up[ k ] + down[ k ] + even[ k ] + even[ k+1 ] ) * 0.25 - c[ k ] );
+      c[ k ] += d;
+      d = fabs( d );
+      maxdiff = ( d > maxdiff )? d : maxdiff;
+    }
+  } else {
+    double *restrict c = grid[ i ];
+    const double *up = grid[ i-1 ], *down = grid[ i+1 ], *odd = grid[ i ] + h;
+    kend = (cols - 2) / 2;
+#pragma omp simd private(d) reduction(max:maxdiff)
+    for (k = 1; k <= kend; ++k) {
+      d = omega * ( ( up[ k ] + down[ k ] + odd[ k-1 ] + odd[ k ] ) * 0.25 - c[ k ] );
+      c[ k ] += d;
+      d = fabs( d );
+      maxdiff = ( d > maxdiff )? d : maxdiff;
+    }
+  }
+  return maxdiff;
+}
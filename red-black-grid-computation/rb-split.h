@@ -0,0 +1,61 @@
+/**
+ * Red/black grid with the two colors stored apart.
+ *
+ * In the usual layout the points of one color are every other element
+ * of a row, so a red or black sweep steps j += 2 and uses half of every
+ * cache line it loads. Here row i of a grid with 'cols' columns is kept
+ * as two packed halves of split_half(cols) elements each:
+ *
+ *   row[ k ]                     = grid[ i ][ 2k ]    (even columns)
+ *   row[ split_half(cols) + k ]  = grid[ i ][ 2k+1 ]  (odd columns)
+ *
+ * A point is red when i+j is even, so in every row one half holds the
+ * red points and the other half the black ones. The four neighbours of
+ * a point are in the same half of rows i-1 and i+1 and in the other
+ * half of row i, which makes the update a unit-stride loop the compiler
+ * vectorizes. The neighbours are added in the same order as in the
+ * interleaved code, so both layouts give bit for bit the same grid.
+ */
+#ifndef RB_SPLIT_H
+#define RB_SPLIT_H
+
+#define RED 0
+#define BLACK 1
+
+/* Number of elements of each half of a row of 'cols' columns. */
+int split_half( int cols );
+
+/* Number of elements of a whole row (both halves). */
+int split_row_length( int cols );
+
+/**
+ * Allocate a rows x cols grid in the split layout, contiguously.
+ */
+double **split_allocate_grid( int rows, int cols );
+
+/**
+ * Set columns 0 and cols-1 of 'row' to 'edge' and the others to 'inner'.
+ */
+void split_fill_row( double *row, int cols, double edge, double inner );
+
+/**
+ * Value of grid[i][j] in the interleaved layout.
+ */
+double split_get( double **grid, int i, int j, int cols );
+
+/**
+ * Update the points of 'color' (RED or BLACK) in columns 1..cols-2 of
+ * row i. The _max variant also returns the largest change, or
+ * 'maxdiff' when that is larger.
+ */
+void split_update_row( double **grid, int i, int cols, int color );
+double split_update_row_max( double **grid, int i, int cols, int color, double maxdiff );
+
+/**
+ * The same with the SOR update of rb-sor.h.
+ */
+void split_sor_update_row( double **grid, int i, int cols, int color, double omega );
+double split_sor_update_row_max( double **grid, int i, int cols, int color, double omega,
+				 double maxdiff );
+
+#endif
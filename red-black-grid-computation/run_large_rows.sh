@@ -0,0 +1,41 @@
+#!/bin/bash
+
+# hybrid-rb on 2 ranks with rows larger than the eager limit of the MPI
+# library (4 KB, i.e. a grid size of about 500, for shared memory in
+# Open MPI; 12 KB to 64 KB for most networks). With the old blocking
+# MPI_Send/MPI_Recv halo exchange these sizes deadlocked; a run that has
+# not finished after $limit seconds is reported as a hang. Every run
+# must also give the same max difference as seq-rb.
+#
+# Memory: seq-rb and hybrid-rb each keep 8*N*N bytes, i.e. 8 GB for
+# 32768 (split over the two ranks for hybrid-rb).
+
+# compile the code
+make seq-rb
+make hybrid-rb
+
+# file for outputs
+output="output_large_rows.txt"
+rm -f $output
+
+num_iters=10
+limit=600
+failed=0
+
+for gridsize in 600 4000 32768
+do
+    echo "grid size: $gridsize" >> $output
+    expected=$(./seq-rb $gridsize $num_iters | grep -o "Max difference:[0-9.]*")
+    result=$(timeout $limit mpirun -np 2 --hostfile hostfile ./hybrid-rb $gridsize $num_iters 2)
+    status=$?
+    echo "$result" >> $output
+    if [ $status -eq 124 ]; then
+	echo "FAIL: hybrid-rb $gridsize hangs" | tee -a $output
+	failed=1
+    elif [ $status -ne 0 ] || [[ "$result" != *"$expected"* ]]; then
+	echo "FAIL: hybrid-rb $gridsize (expected $expected)" | tee -a $output
+	failed=1
+    fi
+done
+
+exit $failed
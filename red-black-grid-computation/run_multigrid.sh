@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Multigrid (-m): number of V- and W-cycles needed to bring the max
+# difference of a sweep below the tolerance, for grid sizes from 2800 to
+# 32000, with seq-rb and with dist-rb on 4 and 8 ranks. The number of
+# cycles should not grow with the grid size (6 for V and W with this
+# tolerance; dist-rb reports one more because its convergence
+# check lags one iteration behind).
+#
+# Memory: seq-rb keeps the grid and its residual (16*N*N bytes) and the
+# three arrays of every coarse level (about 8*N*N bytes together), i.e.
+# 3 GB for 11200, 12 GB for 22400 and 25 GB for 32000 (divided over the
+# ranks for dist-rb).
+
+# compile the code
+make seq-rb
+make dist-rb
+
+# file for outputs
+output="output_multigrid.txt"
+rm -f $output
+
+max_cycles=50
+tolerance=1e-9
+
+for gridsize in 2800 5600 11200 22400 32000
+do
+    echo "grid size: $gridsize" >> $output
+    for c in V W
+    do
+	echo "seq-rb -m $c" >> $output
+	./seq-rb -m $c -e $tolerance -k 1 $gridsize $max_cycles >> $output
+	for np in 4 8
+	do
+	    echo "dist-rb -m $c $np ranks" >> $output
+	    mpirun -np $np --hostfile hostfile ./dist-rb -m $c -e $tolerance -k 1 $gridsize $max_cycles >> $output
+	done
+    done
+done
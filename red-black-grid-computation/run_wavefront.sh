@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# Temporal blocking of the sequential red-black solver: run seq-rb with
+# 1, 2, 4, 8 and 16 iterations per pass over the grid (-t), in both
+# layouts, and report the runtime together with the DRAM traffic.
+#
+# The traffic is modeled as one read and one write of the grid per pass:
+# 2*num_iters passes without blocking, ceil(num_iters/depth) passes with
+# it, as long as the band of 2*depth+3 rows behind the wavefront fits in
+# the last level cache (its size is printed too). When 'perf' is
+# available the measured last level cache misses are reported as well.
+
+# compile the code
+make seq-rb
+
+# file for outputs
+output="output_wavefront.txt"
+rm -f $output
+
+num_iters=32
+END=3
+
+for gridsize in 2800 8080
+do
+    grid_bytes=$(( (gridsize+2) * (gridsize+2) * 8 ))
+    echo "grid size: $gridsize, $num_iters iterations" >> $output
+    for layout in "" "-s"
+    do
+	for depth in 1 2 4 8 16
+	do
+	    if [ $depth -eq 1 ]; then
+		passes=$(( 2 * num_iters ))
+	    else
+		passes=$(( (num_iters + depth - 1) / depth ))
+	    fi
+	    band_kb=$(( (2*depth + 3) * (gridsize+2) * 8 / 1024 ))
+	    echo "seq-rb $layout -t $depth: band $band_kb KB, modeled DRAM traffic $(( passes * 2 * grid_bytes / 1048576 )) MB" >> $output
+	    for i in $(seq 1 $END)
+	    do
+		./seq-rb $layout -t $depth $gridsize $num_iters >> $output
+	    done
+	    if command -v perf > /dev/null; then
+		perf stat -x, -e LLC-load-misses,LLC-store-misses ./seq-rb $layout -t $depth $gridsize $num_iters 2>&1 > /dev/null |
+		    awk -F, '{ misses += $1 } END { printf "measured LLC misses: %d (%d MB)\n", misses, misses * 64 / 1048576 }' >> $output
+	    fi
+	done
+    done
+done